@@ -0,0 +1,463 @@
+//
+// Benchmark for my_json: parse / validate / jsonStringify / accessors / operator== / minify / prettify.
+//
+// Usage: my_json_bench [--json] [--iterations N] [--scale N] [--seed N] [--dump DIR]
+//   --json        输出每行一个JSON对象，便于脚本记录回归
+//   --iterations  每项测试重复次数，取最快一次
+//   --scale       语料规模倍数
+//   --seed        语料生成种子，同一种子生成的语料完全相同
+//   --dump DIR    把生成的语料写到DIR下，便于和其他库对比
+//
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include "my_json.h"
+#include "my_json_bind.h"
+#include "my_json_columns.h"
+#include "my_json_format.h"
+#include "my_json_ingest.h"
+
+static std::atomic<size_t> alloc_count{0};
+static std::atomic<size_t> alloc_bytes{0};
+
+void *operator new(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+// 固定算法的随机数，保证不同平台/标准库生成的语料一致
+class Random {
+public:
+    explicit Random(unsigned long long seed) : state_(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    unsigned long long next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+    unsigned range(unsigned n) { return (unsigned) (next() % n); }
+
+    double real() { return (double) (next() >> 11) / (double) (1ull << 53); }
+
+private:
+    unsigned long long state_;
+};
+
+struct LogEntry {
+    double ts = 0;
+    std::string level;
+    std::string msg;
+    std::string host;
+};
+
+MY_JSON_BINDING(LogEntry, MY_JSON_FIELD(LogEntry, ts), MY_JSON_FIELD(LogEntry, level),
+                MY_JSON_FIELD(LogEntry, msg), MY_JSON_FIELD(LogEntry, host))
+
+struct Corpus {
+    std::string name;
+    std::string json;
+};
+
+static void appendNumber(std::string &json, double d) {
+    char buffer[32];
+    sprintf(buffer, "%.17g", d);
+    json += buffer;
+}
+
+static void appendWord(std::string &json, Random &random) {
+    static const char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon", "request", "response",
+                                  "user", "session", "timeout", "error", "ok", "GET", "POST", "/api/v1"};
+    json += words[random.range(sizeof(words) / sizeof(words[0]))];
+}
+
+static void appendString(std::string &json, Random &random, unsigned words, bool escapes) {
+    json += '"';
+    for (unsigned i = 0; i < words; i++) {
+        if (i) json += ' ';
+        appendWord(json, random);
+        if (escapes && random.range(8) == 0) {
+            static const char *escapeSeq[] = {"\\n", "\\t", "\\\"", "\\\\", "\\u00e9", "\\u4e2d", "\\ud83d\\ude00"};
+            json += escapeSeq[random.range(sizeof(escapeSeq) / sizeof(escapeSeq[0]))];
+        }
+    }
+    json += '"';
+}
+
+static std::string numbersCorpus(Random &random, unsigned scale) {
+    std::string json = "[";
+    for (unsigned i = 0; i < 20000 * scale; i++) {
+        if (i) json += ',';
+        switch (random.range(3)) {
+            case 0:
+                appendNumber(json, (double) random.range(1000000));
+                break;
+            case 1:
+                appendNumber(json, (random.real() - 0.5) * 1e6);
+                break;
+            default:
+                appendNumber(json, random.real() * 1e-8);
+        }
+    }
+    json += ']';
+    return json;
+}
+
+static std::string logsCorpus(Random &random, unsigned scale) {
+    std::string json = "[";
+    for (unsigned i = 0; i < 2000 * scale; i++) {
+        if (i) json += ',';
+        json += "{\"ts\":";
+        appendNumber(json, 1681000000.0 + i);
+        json += ",\"level\":";
+        appendString(json, random, 1, false);
+        json += ",\"msg\":";
+        appendString(json, random, 8 + random.range(16), true);
+        json += ",\"host\":";
+        appendString(json, random, 1, false);
+        json += '}';
+    }
+    json += ']';
+    return json;
+}
+
+static void appendNested(std::string &json, Random &random, unsigned depth) {
+    if (depth == 0) {
+        appendNumber(json, random.range(100));
+        return;
+    }
+    if (depth % 2) {
+        json += '[';
+        appendNested(json, random, depth - 1);
+        json += ",true,null]";
+    } else {
+        json += "{\"name\":";
+        appendString(json, random, 1, false);
+        json += ",\"child\":";
+        appendNested(json, random, depth - 1);
+        json += '}';
+    }
+}
+
+static std::string nestedCorpus(Random &random, unsigned scale) {
+    std::string json = "[";
+    for (unsigned i = 0; i < 200 * scale; i++) {
+        if (i) json += ',';
+        appendNested(json, random, 32);
+    }
+    json += ']';
+    return json;
+}
+
+static std::string wideCorpus(Random &random, unsigned scale) {
+    std::string json = "{";
+    for (unsigned i = 0; i < 5000 * scale; i++) {
+        if (i) json += ',';
+        json += "\"field_" + std::to_string(i) + "\":";
+        if (random.range(2)) appendNumber(json, random.range(100000));
+        else appendString(json, random, 1, false);
+    }
+    json += '}';
+    return json;
+}
+
+// canada(坐标数组) + twitter(带转义的长文本) + citm(id映射表) 风格的混合文档
+static std::string mixedCorpus(Random &random, unsigned scale) {
+    std::string json = "{\"type\":\"FeatureCollection\",\"coordinates\":[";
+    for (unsigned i = 0; i < 2000 * scale; i++) {
+        if (i) json += ',';
+        json += '[';
+        appendNumber(json, -180 + random.real() * 360);
+        json += ',';
+        appendNumber(json, -90 + random.real() * 180);
+        json += ']';
+    }
+    json += "],\"statuses\":[";
+    for (unsigned i = 0; i < 200 * scale; i++) {
+        if (i) json += ',';
+        json += "{\"id\":";
+        appendNumber(json, 505874924095815681.0 + i);
+        json += ",\"text\":";
+        appendString(json, random, 20, true);
+        json += ",\"retweeted\":";
+        json += random.range(2) ? "true" : "false";
+        json += ",\"user\":{\"screen_name\":";
+        appendString(json, random, 1, false);
+        json += ",\"followers_count\":";
+        appendNumber(json, random.range(100000));
+        json += "},\"in_reply_to\":null}";
+    }
+    json += "],\"events\":{";
+    for (unsigned i = 0; i < 500 * scale; i++) {
+        if (i) json += ',';
+        json += "\"" + std::to_string(138586341 + i) + "\":{\"name\":";
+        appendString(json, random, 3, false);
+        json += ",\"subTopicIds\":[";
+        appendNumber(json, 337184269 + random.range(100));
+        json += ',';
+        appendNumber(json, 337184283 + random.range(100));
+        json += "],\"logo\":null}";
+    }
+    json += "}}";
+    return json;
+}
+
+static std::vector<Corpus> makeCorpora(unsigned long long seed, unsigned scale) {
+    std::vector<Corpus> corpora;
+    Random random(seed);
+    corpora.push_back({"numbers", numbersCorpus(random, scale)});
+    corpora.push_back({"logs", logsCorpus(random, scale)});
+    corpora.push_back({"nested", nestedCorpus(random, scale)});
+    corpora.push_back({"wide", wideCorpus(random, scale)});
+    corpora.push_back({"mixed", mixedCorpus(random, scale)});
+    return corpora;
+}
+
+static size_t countNodes(MyJSON &json) {
+    size_t count = 1;
+    if (json.getType() == JSON_ARRAY) {
+        for (auto &element: json.getArray()) count += countNodes(element);
+    } else if (json.getType() == JSON_OBJECT) {
+        for (auto &key: json.getKeys()) {
+            auto value = json.getValueFromKey(key);
+            count += countNodes(value);
+        }
+    }
+    return count;
+}
+
+// 访问器测试：遍历整棵树读取每个值
+static double visit(MyJSON &json) {
+    switch (json.getType()) {
+        case JSON_NUMBER:
+            return json.getNumber();
+        case JSON_STRING:
+            return (double) json.getString().size();
+        case JSON_ARRAY: {
+            double sum = 0;
+            for (auto &element: json.getArray()) sum += visit(element);
+            return sum;
+        }
+        case JSON_OBJECT: {
+            double sum = 0;
+            for (auto &key: json.getKeys()) {
+                auto value = json.getValueFromKey(key);
+                sum += visit(value);
+            }
+            return sum;
+        }
+        default:
+            return 1;
+    }
+}
+
+struct Measurement {
+    double seconds;
+    size_t allocs;
+    size_t allocBytes;
+};
+
+template<typename F>
+static Measurement measure(int iterations, F &&f) {
+    Measurement best{1e300, 0, 0};
+    for (int i = 0; i < iterations; i++) {
+        size_t count = alloc_count.load();
+        size_t bytes = alloc_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if (seconds < best.seconds) {
+            best = {seconds, alloc_count.load() - count, alloc_bytes.load() - bytes};
+        }
+    }
+    return best;
+}
+
+static volatile double sink;
+
+static void report(bool jsonOutput, const Corpus &corpus, const char *op, size_t nodes, const Measurement &m,
+                   size_t bytes = 0) {
+    if (bytes == 0) bytes = corpus.json.size();
+    double mbps = bytes / m.seconds / (1024 * 1024);
+    double nsPerNode = m.seconds * 1e9 / nodes;
+    if (jsonOutput) {
+        printf("{\"corpus\":\"%s\",\"op\":\"%s\",\"bytes\":%zu,\"nodes\":%zu,\"seconds\":%.9f,"
+               "\"mb_per_s\":%.3f,\"ns_per_node\":%.3f,\"allocs\":%zu,\"alloc_bytes\":%zu}\n",
+               corpus.name.c_str(), op, bytes, nodes, m.seconds, mbps, nsPerNode, m.allocs, m.allocBytes);
+    } else {
+        printf("%-8s %-10s %10zu %8zu %10.2f %10.2f %10zu %12zu\n",
+               corpus.name.c_str(), op, bytes, nodes, mbps, nsPerNode, m.allocs, m.allocBytes);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool jsonOutput = false;
+    int iterations = 5;
+    unsigned scale = 1;
+    unsigned long long seed = 2023;
+    const char *dumpDir = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) jsonOutput = true;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scale = (unsigned) atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) dumpDir = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--json] [--iterations N] [--scale N] [--seed N] [--dump DIR]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1) iterations = 1;
+    if (scale < 1) scale = 1;
+
+    auto corpora = makeCorpora(seed, scale);
+    if (dumpDir) {
+        for (auto &corpus: corpora) {
+            std::string path = std::string(dumpDir) + "/" + corpus.name + ".json";
+            FILE *file = fopen(path.c_str(), "wb");
+            if (!file) {
+                fprintf(stderr, "can't open %s\n", path.c_str());
+                return 1;
+            }
+            fwrite(corpus.json.data(), 1, corpus.json.size(), file);
+            fclose(file);
+        }
+    }
+
+    if (!jsonOutput) {
+        printf("%-8s %-10s %10s %8s %10s %10s %10s %12s\n",
+               "corpus", "op", "bytes", "nodes", "MB/s", "ns/node", "allocs", "alloc_bytes");
+    }
+    for (auto &corpus: corpora) {
+        MyJSON json;
+        if (json.parse(corpus.json.c_str()) != PARSE_OK) {
+            fprintf(stderr, "%s: parse failed\n", corpus.name.c_str());
+            return 1;
+        }
+        MyJSON other;
+        other.parse(corpus.json.c_str());
+        size_t nodes = countNodes(json);
+
+        report(jsonOutput, corpus, "parse", nodes, measure(iterations, [&] {
+            MyJSON parsed;
+            parsed.parse(corpus.json.c_str());
+        }));
+        report(jsonOutput, corpus, "strict", nodes, measure(iterations, [&] {
+            MyJSON parsed;
+            parsed.parse<JSONStrictPolicy>(corpus.json.c_str());
+        }));
+        report(jsonOutput, corpus, "trusted", nodes, measure(iterations, [&] {
+            MyJSON parsed;
+            parsed.parse<JSONTrustedPolicy>(corpus.json.c_str());
+        }));
+        // 解析器在计时前先解析一次，测量的是复用存储后的稳定状态
+        JSONParser parser;
+        parser.parse(corpus.json.c_str());
+        report(jsonOutput, corpus, "reparse", nodes, measure(iterations, [&] {
+            parser.parse(corpus.json.c_str());
+        }));
+        report(jsonOutput, corpus, "validate", nodes, measure(iterations, [&] {
+            sink = MyJSON::validate(corpus.json.data(), corpus.json.size());
+        }));
+        report(jsonOutput, corpus, "utf8valid", nodes, measure(iterations, [&] {
+            sink = MyJSON::validate(corpus.json.data(), corpus.json.size(), nullptr, true);
+        }));
+        report(jsonOutput, corpus, "stringify", nodes, measure(iterations, [&] {
+            std::string out;
+            json.jsonStringify(out);
+            sink = (double) out.size();
+        }));
+        report(jsonOutput, corpus, "access", nodes, measure(iterations, [&] {
+            sink = visit(json);
+        }));
+        report(jsonOutput, corpus, "equals", nodes, measure(iterations, [&] {
+            sink = json == other;
+        }));
+        std::string pretty;
+        report(jsonOutput, corpus, "prettify", nodes, measure(iterations, [&] {
+            pretty.clear();
+            JSONFormatter::prettify(corpus.json.data(), corpus.json.size(), pretty);
+        }));
+        report(jsonOutput, corpus, "minify", nodes, measure(iterations, [&] {
+            std::string out;
+            JSONFormatter::minify(pretty.data(), pretty.size(), out);
+            sink = (double) out.size();
+        }), pretty.size());
+        report(jsonOutput, corpus, "memcpy", nodes, measure(iterations, [&] {
+            std::string out(pretty);
+            sink = (double) out.size();
+        }), pretty.size());
+        if (corpus.name == "mixed") {
+            JSONProjection projection{"type", "statuses.id", "statuses.user.screen_name"};
+            report(jsonOutput, corpus, "project", nodes, measure(iterations, [&] {
+                MyJSON parsed;
+                parsed.parse(corpus.json.c_str(), projection);
+            }));
+        }
+        if (corpus.name == "logs") {
+            JSONKeyTable keys;
+            JSONParseOptions options;
+            options.keys = &keys;
+            report(jsonOutput, corpus, "intern", nodes, measure(iterations, [&] {
+                MyJSON parsed;
+                parsed.parse(corpus.json.c_str(), options);
+            }));
+            report(jsonOutput, corpus, "bind", nodes, measure(iterations, [&] {
+                std::vector<LogEntry> entries;
+                jsonParse(corpus.json.c_str(), entries);
+                sink = (double) entries.size();
+            }));
+            // 文件在页缓存中，测的是读文件与解析重叠后的吞吐
+            const char *path = "my_json_bench_ingest.json";
+            if (FILE *file = fopen(path, "wb")) {
+                fwrite(corpus.json.data(), 1, corpus.json.size(), file);
+                fclose(file);
+                report(jsonOutput, corpus, "readparse", nodes, measure(iterations, [&] {
+                    std::string text;
+                    FILE *in = fopen(path, "rb");
+                    char buffer[1 << 16];
+                    size_t n;
+                    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) text.append(buffer, n);
+                    fclose(in);
+                    MyJSON parsed;
+                    parsed.parse(text.c_str());
+                }));
+                JSONIngestOptions options;
+                options.format = INGEST_JSON_ARRAY;
+                options.bufferSize = 256 << 10;
+                JSONIngest ingest(options);
+                report(jsonOutput, corpus, "ingest", nodes, measure(iterations, [&] {
+                    ingest.run(path, [](size_t, MyJSON &value, unsigned) { sink = (double) value.getType(); });
+                }));
+                remove(path);
+            }
+            JSONColumns columns;
+            columns.addColumn("ts", COLUMN_DOUBLE);
+            columns.addColumn("level", COLUMN_STRING);
+            columns.addColumn("msg", COLUMN_STRING);
+            columns.addColumn("host", COLUMN_STRING);
+            report(jsonOutput, corpus, "columns", nodes, measure(iterations, [&] {
+                columns.parse(corpus.json.c_str());
+                sink = (double) columns.rows();
+            }));
+        }
+    }
+    return 0;
+}
@@ -2,62 +2,130 @@
 // Created by 19148 on 2023/4/12.
 //
 #include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
 #include "my_json.h"
+#include "my_json_internal.h"
+
+#ifdef MY_JSON_STATS
+
+#include <atomic>
+
+static JSONStatsHooks statsHooks;
+static std::atomic<unsigned> statsCounter{0};
+// 当前线程正在统计的jsonStringify
+static thread_local JSONStats *stringifyStats = nullptr;
+static thread_local size_t stringifyDepth = 0;
+
+bool jsonStatsSampled() {
+    if (!statsHooks.report) return false;
+    unsigned rate = statsHooks.sampleRate ? statsHooks.sampleRate : 1;
+    return statsCounter.fetch_add(1, std::memory_order_relaxed) % rate == 0;
+}
+
+std::chrono::steady_clock::time_point jsonStatsBegin(JSONStats &stats, JSONStatsOp op) {
+    stats = JSONStats();
+    stats.op = op;
+    if (statsHooks.readAllocCounter) statsHooks.readAllocCounter(stats.allocs, stats.allocBytes);
+    return std::chrono::steady_clock::now();
+}
+
+double jsonStatsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void jsonStatsEnd(JSONStats &stats, std::chrono::steady_clock::time_point start) {
+    stats.seconds = jsonStatsSince(start);
+    stats.phaseSeconds[PHASE_STRUCTURE] =
+            std::max(stats.seconds - stats.phaseSeconds[PHASE_STRING] - stats.phaseSeconds[PHASE_NUMBER], 0.0);
+    if (statsHooks.readAllocCounter) {
+        size_t count, bytes;
+        statsHooks.readAllocCounter(count, bytes);
+        stats.allocs = count - stats.allocs;
+        stats.allocBytes = bytes - stats.allocBytes;
+    }
+    statsHooks.report(stats);
+}
+
+#endif
+
+void MyJSON::setStatsHooks(const JSONStatsHooks &hooks) {
+#ifdef MY_JSON_STATS
+    statsHooks = hooks;
+#else
+    (void) hooks;
+#endif
+}
 
 double MyJSON::getNumber() {
     assert(type_ == JSON_NUMBER);
+    if (!value_.nDecoded) {
+        value_.nVal = numberValue();
+        value_.nDecoded = true;
+    }
     return value_.nVal;
 }
 
+double MyJSON::numberValue() const {
+    return value_.nDecoded ? value_.nVal : strtod(value_.sVal.c_str(), nullptr);
+}
+
+int64_t MyJSON::getInt64() {
+    assert(type_ == JSON_NUMBER);
+    const std::string &raw = value_.sVal;
+    if (!raw.empty() && raw.find_first_of(".eE") == std::string::npos) {
+        // 整数按原文转换，超过19位的ID也不经过double
+        errno = 0;
+        long long n = strtoll(raw.c_str(), nullptr, 10);
+        if (errno != ERANGE) return n;
+    }
+    double d = getNumber();
+    if (d >= 9223372036854775807.0) return INT64_MAX;
+    if (d <= -9223372036854775808.0) return INT64_MIN;
+    return (int64_t) d;
+}
+
+std::string MyJSON::getRawNumber() {
+    assert(type_ == JSON_NUMBER);
+    if (!value_.sVal.empty()) return value_.sVal;
+    std::string sjson;
+    numberStringify(sjson);
+    return sjson;
+}
+
 std::vector<MyJSON> MyJSON::getArray() {
     assert(type_ == JSON_ARRAY);
     return value_.arrVal;
 }
 
-JSONParseResult MyJSON::parse(const char *json) {
-    MyContext context;
-    context.json = json;
-    type_ = JSON_NULL;
-    parseWhitespace(context);
-    JSONParseResult ret = parseValue(context);
-    if (ret == PARSE_OK) {
-        parseWhitespace(context);
-        if (*context.json != '\0') {
-            type_ = JSON_NULL;
-            ret = PARSE_ROOT_NOT_SINGULAR;
-        }
-    }
-    return ret;
+// 运行时的validateUTF8选择对应的实例
+using JSONDefaultUTF8Policy = JSONPolicy<false, true, NUMBER_RAW, 0, true>;
+
+JSONParseResult MyJSON::parse(const char *json, bool validateUTF8) {
+    JSONParseOptions options;
+    options.validateUTF8 = validateUTF8;
+    return parse(json, options);
 }
 
+JSONParseResult MyJSON::parse(const char *json, const JSONProjection &projection, bool validateUTF8) {
+    JSONParseOptions options;
+    options.validateUTF8 = validateUTF8;
+    options.projection = &projection;
+    return parse(json, options);
+}
 
-void MyJSON::parseWhitespace(MyContext &context) {
-    const char *p = context.json;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
-        p++;
-    }
-    context.json = p;
+JSONParseResult MyJSON::parse(const char *json, const JSONParseOptions &options) {
+    MyContext context;
+    return parseRoot(context, json, options);
 }
 
-JSONParseResult MyJSON::parseValue(MyContext &context) {
-    switch (*context.json) {
-        case 'n':
-            return parseNull(context);
-        case 't':
-            return parseTrue(context);
-        case 'f':
-            return parseFalse(context);
-        case '\"':
-            return parseString(context);
-        case '[':
-            return parseArray(context);
-        case '{':
-            return parseObject(context);
-        case '\0':
-            return PARSE_EXPECT_VALUE;
-        default:
-            return parseNumber(context);
-    }
+JSONParseResult MyJSON::parseRoot(MyContext &context, const char *json, const JSONParseOptions &options) {
+    if (options.validateUTF8) return parseRoot<JSONDefaultUTF8Policy>(context, json, options);
+    return parseRoot<JSONDefaultPolicy>(context, json, options);
 }
 
 JSONParseResult MyJSON::parseNull(MyContext &context) {
@@ -99,175 +167,68 @@ JSONParseResult MyJSON::parseValue(MyContext &context, const char *value, JSONTy
     return PARSE_OK;
 }
 
-inline bool isDigit(const char ch) {
-    return ch >= '0' && ch <= '9';
-}
-
-inline bool isDigit1to9(const char ch) {
-    return ch >= '1' && ch <= '9';
-}
-
-JSONParseResult MyJSON::parseNumber(MyContext &context) {
-    const char *p = context.json;
-    if (*p == '-') p++;
-    if (*p == '0') p++;
-    else {
-        if (!isDigit1to9(*p)) return PARSE_INVALID_VALUE;
-        do { p++; } while (isDigit(*p));
-    }
-    if (*p == '.') {
-        p++;
-        if (!isDigit(*p)) return PARSE_INVALID_VALUE;
-        do { p++; } while (isDigit(*p));
-    }
-    if (*p == 'e' || *p == 'E') {
-        p++;
-        if (*p == '+' || *p == '-') p++;
-        if (!isDigit(*p)) return PARSE_INVALID_VALUE;
-        do { p++; } while (isDigit(*p));
-    }
-    errno = 0;
-    value_.nVal = strtod(context.json, nullptr);
-    if (errno == ERANGE && (value_.nVal == HUGE_VAL || value_.nVal == -HUGE_VAL)) {
-        return PARSE_NUMBER_TOO_BIG;
+void JSONProjection::add(const std::string &path) {
+    std::vector<std::string> keys;
+    size_t start = 0;
+    while (true) {
+        size_t dot = path.find('.', start);
+        keys.push_back(path.substr(start, dot - start));
+        if (dot == std::string::npos) break;
+        start = dot + 1;
     }
-
-    context.json = p;
-    type_ = JSONType::JSON_NUMBER;
-    return PARSE_OK;
-}
-
-inline bool isHexDigitUpperChar(const char ch) {
-    return 'A' < ch && ch < 'F';
-}
-
-inline bool isHexDigitLowerChar(const char ch) {
-    return 'a' < ch && ch < 'f';
-}
-
-inline bool isHexDigit(const char ch) {
-    return isDigit(ch) || isHexDigitUpperChar(ch) || isHexDigitLowerChar(ch);
-}
-
-void getHexDigit(const char p, unsigned &u) {
-    assert(isHexDigit(p));
-    if (isDigit(p)) {
-        u = u * 16 + (p - '0');
-    } else if (isHexDigitLowerChar(p)) {
-        u = u * 16 + (p - 'a');
-    } else {
-        u = u * 16 + (p - 'A');
+    add(keys);
+}
+
+void JSONProjection::add(const std::vector<std::string> &keys) {
+    size_t node = 0;
+    for (auto &key: keys) {
+        if (nodes_[node].all) return;
+        auto iter = nodes_[node].children.find(key);
+        if (iter == nodes_[node].children.end()) {
+            // 先插入子节点再取引用，push_back可能使引用失效
+            nodes_.emplace_back();
+            iter = nodes_[node].children.emplace(key, nodes_.size() - 1).first;
+        }
+        node = iter->second;
     }
+    nodes_[node].all = true;
+    nodes_[node].children.clear();
 }
 
-bool parse_hex4(const char *&p, unsigned &u) {
-    char *end;
-    u = (unsigned) strtol(p, &end, 16);
-    if (end == p + 4) {
-        p += 4;
-        return true;
-    }
-    return false;
+const JSONSymbol *JSONKeyTable::findLocked(std::string_view key) const {
+    auto iter = symbols_.find(key);
+    return iter == symbols_.end() ? nullptr : iter->second.get();
 }
 
-void MyJSON::encodeUTF8(MyContext &context, unsigned u) {
-    if (u <= 0x7f)
-        context.chStack.push(u & 0xff);
-    else if (u <= 0x7ff) {
-        context.chStack.push(0xc0 | ((u >> 6) & 0xff));
-        context.chStack.push(0x80 | (u & 0x3f));
-    } else if (u <= 0xffff) {
-        context.chStack.push(0xe0 | ((u >> 12) & 0xff));
-        context.chStack.push(0x80 | ((u >> 6)) & 0x3f);
-        context.chStack.push(0x80 | (u & 0x3f));
-    } else {
-        assert(u <= 0x10ffff);
-        context.chStack.push(0xf0 | (u >> 18) & 0xff);
-        context.chStack.push(0x80 | (u >> 12) & 0x3f);
-        context.chStack.push(0x80 | ((u >> 6)) & 0x3f);
-        context.chStack.push(0x80 | (u) & 0x3f);
-    }
+const JSONSymbol *JSONKeyTable::find(std::string_view key) const {
+    if (!threadSafe_) return findLocked(key);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return findLocked(key);
 }
 
-JSONParseResult MyJSON::parseStringRaw(MyJSON::MyContext &context, std::string &value) {
-    assert(*context.json == '\"');
-    context.json++;
-    const char *p = context.json;
-    while (true) {
-        char ch = *p++;
-        switch (ch) {
-            case '\"':
-                setString(context.chStack, value);
-                context.json = p;
-                return PARSE_OK;
-            case '\0':
-                return PARSE_MISS_QUOTATION_MARK;
-            case '\\': {
-                char ch = *p++;
-                switch (ch) {
-                    case 'n':
-                        context.chStack.push('\n');
-                        break;
-                    case '\\':
-                        context.chStack.push('\\');
-                        break;
-                    case '\"':
-                        context.chStack.push('\"');
-                        break;
-                    case '/':
-                        context.chStack.push('/');
-                        break;
-                    case 'b':
-                        context.chStack.push('\b');
-                        break;
-                    case 'f':
-                        context.chStack.push('\f');
-                        break;
-                    case 'r':
-                        context.chStack.push('\r');
-                        break;
-                    case 't':
-                        context.chStack.push('\t');
-                        break;
-                    case 'u':
-                        unsigned u;
-                        if (!parse_hex4(p, u)) return PARSE_INVALID_UNICODE_HEX;
-                        if (u >= 0xd800 && u < 0xdbff) {
-                            if (*p++ != '\\')return PARSE_INVALID_UNICODE_SURROGATE;
-                            if (*p++ != 'u')return PARSE_INVALID_UNICODE_SURROGATE;
-                            unsigned u2;
-                            if (!parse_hex4(p, u2)) return PARSE_INVALID_UNICODE_HEX;
-                            if (u2 < 0xd800 || u2 > 0xdfff) return PARSE_INVALID_UNICODE_SURROGATE;
-                            u = (((u - 0xd800) << 10) | (u2 - 0xdc00)) + 0x10000;
-                        }
-                        encodeUTF8(context, u);
-                        break;
-                    default:
-                        return PARSE_INVALID_STRING_ESCAPE;
-                }
-                break;
-            }
-            default:
-                if (ch < 0x20) return PARSE_INVALID_STRING_CHAR;
-                context.chStack.push(ch);
-        }
+const JSONSymbol *JSONKeyTable::intern(std::string_view key) {
+    if (threadSafe_) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (const JSONSymbol *symbol = findLocked(key)) return symbol;
+    } else if (const JSONSymbol *symbol = findLocked(key)) {
+        return symbol;
     }
-}
-
-JSONParseResult MyJSON::parseString(MyContext &context) {
-    auto ret = parseStringRaw(context, value_.sVal);
-    if (ret == PARSE_OK) {
-        type_ = JSON_STRING;
+    std::unique_lock<std::shared_mutex> lock(mutex_, std::defer_lock);
+    if (threadSafe_) {
+        lock.lock();
+        // 等待独占锁期间可能已被其他线程插入
+        if (const JSONSymbol *symbol = findLocked(key)) return symbol;
     }
+    auto symbol = std::make_unique<JSONSymbol>(JSONSymbol{std::string(key)});
+    const JSONSymbol *ret = symbol.get();
+    symbols_.emplace(std::string_view(ret->name), std::move(symbol));
     return ret;
 }
 
-void MyJSON::setString(std::stack<char> &chStack, std::string &value) {
-    value = "";
-    while (!chStack.empty()) {
-        value = chStack.top() + value;
-        chStack.pop();
-    }
+size_t JSONKeyTable::size() const {
+    if (!threadSafe_) return symbols_.size();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return symbols_.size();
 }
 
 std::string MyJSON::getString() {
@@ -275,83 +236,14 @@ std::string MyJSON::getString() {
     return value_.sVal;
 }
 
-JSONParseResult MyJSON::parseArray(MyContext &context) {
-    assert(*context.json == '[');
-    context.json++;
-    JSONParseResult ret = PARSE_OK;
-    parseWhitespace(context);
-    if (*context.json == ']') {
-        context.json++;
-        type_ = JSON_ARRAY;
-        return PARSE_OK;
-    }
-    while (true) {
-        MyJSON subJson;
-        ret = subJson.parseValue(context);
-        parseWhitespace(context);
-        if (ret != PARSE_OK) {
-            return ret;
-        }
-        if (*context.json == ',') {
-            value_.arrVal.push_back(subJson);
-            context.json++;
-        } else if (*context.json == ']') {
-            value_.arrVal.push_back(subJson);
-            context.json++;
-            type_ = JSON_ARRAY;
-            return PARSE_OK;
-        } else
-            return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
-    }
-}
-
-JSONParseResult MyJSON::parseObject(MyJSON::MyContext &context) {
-    assert(*context.json == '{');
-    context.json++;
-    JSONParseResult ret = PARSE_OK;
-    parseWhitespace(context);
-    if (*context.json == '}') {
-        context.json++;
-        type_ = JSON_OBJECT;
-        return ret;
-    }
-    std::string key = "";
-    while (true) {
-        // 解析key
-        MyJSON value;
-        if (*context.json != '"') return PARSE_MISS_KEY;
-        ret = parseStringRaw(context, key);
-        if (ret != PARSE_OK) break;
-
-        // 冒号
-        parseWhitespace(context);
-        if (*context.json != ':') return PARSE_MISS_COLON;
-        context.json++;
-        parseWhitespace(context);
-
-        // 解析value
-        if (key.empty()) return PARSE_MISS_KEY;
-        ret = value.parseValue(context);
-        if (ret != PARSE_OK) break;
-        value_.jVal[key] = value;
-        parseWhitespace(context);
-
-        // 是否又下一个键值对
-        if (*context.json == ',') {
-            context.json++;
-            parseWhitespace(context);
-        } else if (*context.json == '}') {
-            // 该object解析完了
-            context.json++;
-            type_ = JSON_OBJECT;
-            return PARSE_OK;
-        } else {
-            return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-        }
-    }
-
-    return ret;
-}
+// 预定义的策略在这里实例化，my_json.inl中声明为extern template
+template JSONParseResult MyJSON::parseRoot<JSONDefaultPolicy>(MyContext &, const char *, const JSONParseOptions &);
+template JSONParseResult MyJSON::parseRoot<JSONDefaultUTF8Policy>(MyContext &, const char *, const JSONParseOptions &);
+template JSONParseResult MyJSON::parseRoot<JSONStrictPolicy>(MyContext &, const char *, const JSONParseOptions &);
+template JSONParseResult MyJSON::parseRoot<JSONRelaxedPolicy>(MyContext &, const char *, const JSONParseOptions &);
+template JSONParseResult MyJSON::parseRoot<JSONTrustedPolicy>(MyContext &, const char *, const JSONParseOptions &);
+template JSONParseResult MyJSON::parseRoot<JSONDoublePolicy>(MyContext &, const char *, const JSONParseOptions &);
+template JSONParseResult MyJSON::parseRoot<JSONInt64Policy>(MyContext &, const char *, const JSONParseOptions &);
 
 JSONStringifyResult MyJSON::jsonStringify(char *&json) {
     std::string sjson = "";
@@ -361,6 +253,31 @@ JSONStringifyResult MyJSON::jsonStringify(char *&json) {
 }
 
 JSONStringifyResult MyJSON::jsonStringify(std::string &json) {
+#ifdef MY_JSON_STATS
+    if (jsonStatsSampled()) {
+        JSONStats stats;
+        auto start = jsonStatsBegin(stats, STATS_STRINGIFY);
+        size_t size = json.size();
+        stringifyStats = &stats;
+        stringifyDepth = 0;
+        auto ret = valueStringify(json);
+        stringifyStats = nullptr;
+        stats.result = ret;
+        stats.bytes = json.size() - size;
+        jsonStatsEnd(stats, start);
+        return ret;
+    }
+#endif
+    return valueStringify(json);
+}
+
+JSONStringifyResult MyJSON::valueStringify(std::string &json) {
+#ifdef MY_JSON_STATS
+    if (stringifyStats) {
+        if (++stringifyDepth > stringifyStats->maxDepth) stringifyStats->maxDepth = stringifyDepth;
+        stringifyStats->nodes[type_]++;
+    }
+#endif
     std::string sjson = "";
     JSONStringifyResult ret = STRINGIFY_OK;
     switch (type_) {
@@ -387,6 +304,9 @@ JSONStringifyResult MyJSON::jsonStringify(std::string &json) {
             break;
     }
     json += sjson;
+#ifdef MY_JSON_STATS
+    if (stringifyStats) stringifyDepth--;
+#endif
     return ret;
 }
 
@@ -407,15 +327,29 @@ JSONStringifyResult MyJSON::nullStringify(std::string &sjson) {
 
 JSONStringifyResult MyJSON::numberStringify(std::string &sjson) {
     assert(type_ == JSON_NUMBER);
+#ifdef MY_JSON_STATS
+    JSONStatsTimer timer(stringifyStats, PHASE_NUMBER);
+#endif
+    if (!value_.sVal.empty()) {
+        // 解析得到的数字按原文输出
+        sjson += value_.sVal;
+        return STRINGIFY_OK;
+    }
     char buffer[32];
     sprintf(buffer, "%.17g", value_.nVal);
     sjson += buffer;
     return STRINGIFY_OK;
 }
 
-JSONStringifyResult MyJSON::stringStringifyRaw(std::string &sjson, const std::string &value) {
+JSONStringifyResult MyJSON::stringStringifyRaw(std::string &sjson, std::string_view value) {
+#ifdef MY_JSON_STATS
+    JSONStatsTimer timer(stringifyStats, PHASE_STRING);
+#endif
     sjson += '"';
     for (char ch: value) {
+#ifdef MY_JSON_STATS
+        if (stringifyStats && (ch == '\"' || ch == '\\' || (unsigned char) ch < 0x20)) stringifyStats->escapes++;
+#endif
         switch (ch) {
             case '\"':
                 sjson += "\\\"";
@@ -439,7 +373,7 @@ JSONStringifyResult MyJSON::stringStringifyRaw(std::string &sjson, const std::st
                 sjson += "\\t";
                 break;
             default:
-                if (ch < 0x20) {
+                if ((unsigned char) ch < 0x20) {
                     char buffer[7];
                     sprintf(buffer, "\\u%04X", ch);
                     sjson += buffer;
@@ -448,6 +382,10 @@ JSONStringifyResult MyJSON::stringStringifyRaw(std::string &sjson, const std::st
         }
     }
     sjson += '"';
+#ifdef MY_JSON_STATS
+    if (stringifyStats && value.size() > stringifyStats->longestString)
+        stringifyStats->longestString = value.size();
+#endif
     return STRINGIFY_OK;
 }
 
@@ -462,7 +400,7 @@ JSONStringifyResult MyJSON::arrayStringify(std::string &sjson) {
     auto ret = STRINGIFY_OK;
     sjson += '[';
     for (auto iter = value_.arrVal.begin(); iter != value_.arrVal.end(); iter++) {
-        ret = iter->jsonStringify(sjson);
+        ret = iter->valueStringify(sjson);
         if ((iter + 1) != value_.arrVal.end()) {
             sjson += ',';
         }
@@ -475,10 +413,14 @@ JSONStringifyResult MyJSON::objectStringify(std::string &sjson) {
     assert(type_ == JSON_OBJECT);
     auto ret = STRINGIFY_OK;
     sjson += '{';
-    for (auto [key, value]: value_.jVal) {
-        ret = stringStringifyRaw(sjson, key);
+    for (auto iter = value_.jVal.begin(); iter != value_.jVal.end(); iter++) {
+        if (iter != value_.jVal.begin()) {
+            sjson += ',';
+        }
+        auto &[key, value] = *iter;
+        ret = stringStringifyRaw(sjson, key.view());
         sjson += ':';
-        ret = value.jsonStringify(sjson);
+        ret = value.valueStringify(sjson);
     }
     sjson += '}';
     return ret;
@@ -488,24 +430,34 @@ std::vector<std::string> MyJSON::getKeys() {
     assert(type_ = JSON_OBJECT);
     std::vector<std::string> ret;
     std::for_each(value_.jVal.begin(), value_.jVal.end(),
-                  [&ret](std::pair<std::string, MyJSON> member) { ret.push_back(member.first); });
+                  [&ret](const std::pair<const JSONKey, MyJSON> &member) { ret.push_back(member.first.str()); });
     return ret;
 }
 
 MyJSON MyJSON::getValueFromKey(std::string key) {
     if (type_ == JSON_OBJECT) {
-        for (auto [k, v]: value_.jVal) {
-            if (k == key) {
-                return v;
-            }
+        auto iter = value_.jVal.find(key);
+        if (iter != value_.jVal.end()) {
+            return iter->second;
+        }
+    }
+    throw std::out_of_range("json don't has that key");
+}
+
+MyJSON MyJSON::getValueFromKey(const JSONSymbol *symbol) {
+    if (type_ == JSON_OBJECT) {
+        // 按key的顺序查找，遇到同一个符号时只比较指针；不是用该驻留表解析的object按字符串比较
+        auto iter = value_.jVal.find(JSONKey(symbol));
+        if (iter != value_.jVal.end()) {
+            return iter->second;
         }
     }
-    throw std::exception("json don't has that key");
+    throw std::out_of_range("json don't has that key");
 }
 
 void MyJSON::setValueToKey(std::string key, MyJSON myJson) {
     assert(type_ == JSON_OBJECT);
-    value_.jVal[key] = myJson;
+    value_.jVal[JSONKey(std::move(key))] = myJson;
 }
 
 bool arrEquals(const std::vector<MyJSON> &arr1, const std::vector<MyJSON> &arr2) {
@@ -519,11 +471,12 @@ bool arrEquals(const std::vector<MyJSON> &arr1, const std::vector<MyJSON> &arr2)
 }
 
 
-bool objEquals(std::map<std::string, MyJSON> map1, std::map<std::string, MyJSON> map2) {
+bool objEquals(const std::map<JSONKey, MyJSON, std::less<>> &map1, const std::map<JSONKey, MyJSON, std::less<>> &map2) {
     bool ret = map1.size() == map2.size();
     if (ret) {
-        for (auto [key, value]: map1) {
-            ret = ret && value == map2[key];
+        // 两边key按相同顺序排列，逐对比较即可
+        for (auto iter1 = map1.begin(), iter2 = map2.begin(); ret && iter1 != map1.end(); iter1++, iter2++) {
+            ret = iter1->first.view() == iter2->first.view() && iter1->second == iter2->second;
         }
     }
     return ret;
@@ -539,14 +492,311 @@ bool MyJSON::operator==(const MyJSON &json) const {
             case JSON_NULL:
                 return ret;
             case JSON_NUMBER:
-                return value_.nVal == json.value_.nVal;
+                return numberValue() == json.numberValue();
             case JSON_STRING:
                 return value_.sVal == json.value_.sVal;
             case JSON_ARRAY:
                 return arrEquals(value_.arrVal, json.value_.arrVal);
             case JSON_OBJECT:
-                return objEquals(value_.jVal, value_.jVal);
+                return objEquals(value_.jVal, json.value_.jVal);
         }
     }
     return ret;
 }
+
+// 超出短字符串缓冲区时才占用堆内存
+static size_t stringHeapBytes(const std::string &value) {
+    static const size_t inlineCapacity = std::string().capacity();
+    return value.capacity() > inlineCapacity ? value.capacity() + 1 : 0;
+}
+
+static size_t stringSlackBytes(const std::string &value) {
+    return stringHeapBytes(value) ? value.capacity() - value.size() : 0;
+}
+
+JSONMemoryUsage MyJSON::memoryUsage() const {
+    JSONMemoryUsage usage{};
+    addMemoryUsage(usage);
+    usage.total = sizeof(MyJSON);
+    for (size_t bytes: usage.bytes) usage.total += bytes;
+    return usage;
+}
+
+// 当前节点持有的堆内存记到它的类型上，子节点递归统计
+void MyJSON::addMemoryUsage(JSONMemoryUsage &usage) const {
+    // rb-tree节点头部：颜色和三个指针
+    constexpr size_t mapNodeBytes = 4 * sizeof(void *) + sizeof(std::pair<const JSONKey, MyJSON>);
+    size_t strings = stringHeapBytes(value_.sVal);
+    size_t arrays = value_.arrVal.capacity() * sizeof(MyJSON);
+    size_t maps = value_.jVal.size() * mapNodeBytes;
+    size_t keys = 0;
+    for (auto &member: value_.jVal) {
+        if (!member.first.symbol()) keys += stringHeapBytes(member.first.str());
+        member.second.addMemoryUsage(usage);
+    }
+    for (auto &element: value_.arrVal) element.addMemoryUsage(usage);
+    usage.nodes[type_]++;
+    usage.bytes[type_] += strings + arrays + maps + keys;
+    usage.stringBytes += strings;
+    usage.keyBytes += keys;
+    usage.containerBytes += arrays + maps;
+    usage.slackBytes += (value_.arrVal.capacity() - value_.arrVal.size()) * sizeof(MyJSON);
+    // 其他类型的节点中留下的字符串和map全部是余量
+    if (type_ == JSON_STRING || type_ == JSON_NUMBER) usage.slackBytes += stringSlackBytes(value_.sVal);
+    else usage.slackBytes += strings;
+    if (type_ != JSON_OBJECT) usage.slackBytes += maps;
+}
+
+void MyJSON::compact(bool relocate) {
+    if (type_ == JSON_STRING || type_ == JSON_NUMBER) value_.sVal.shrink_to_fit();
+    else std::string().swap(value_.sVal);
+    if (type_ == JSON_ARRAY) {
+        value_.arrVal.shrink_to_fit();
+        for (auto &element: value_.arrVal) element.compact();
+    } else {
+        std::vector<MyJSON>().swap(value_.arrVal);
+    }
+    if (type_ == JSON_OBJECT) {
+        for (auto &member: value_.jVal) member.second.compact();
+    } else {
+        value_.jVal.clear();
+    }
+    if (relocate) {
+        // 复制构造只分配实际需要的大小；旧树在复制完成后才释放，新节点依次分配
+        MyJSON copy(*this);
+        *this = std::move(copy);
+    }
+}
+
+namespace {
+
+// 未闭合括号的栈，每层一位：0为'['，1为'{'。前INLINE_DEPTH层放在对象内，更深时才在堆上扩展
+class BracketStack {
+public:
+    static constexpr size_t INLINE_DEPTH = 4096;
+
+    bool empty() const { return size_ == 0; }
+
+    bool topIsObject() const {
+        size_t i = size_ - 1;
+        return (word(i / 64) >> (i % 64)) & 1;
+    }
+
+    void push(bool object) {
+        size_t w = size_ / 64;
+        if (w >= INLINE_WORDS && w - INLINE_WORDS == heap_.size()) heap_.push_back(0);
+        uint64_t &bits = w < INLINE_WORDS ? inline_[w] : heap_[w - INLINE_WORDS];
+        uint64_t mask = (uint64_t) 1 << (size_ % 64);
+        bits = object ? bits | mask : bits & ~mask;
+        size_++;
+    }
+
+    void pop() { size_--; }
+
+private:
+    static constexpr size_t INLINE_WORDS = INLINE_DEPTH / 64;
+
+    uint64_t inline_[INLINE_WORDS];
+    std::vector<uint64_t> heap_;
+    size_t size_ = 0;
+
+    uint64_t word(size_t w) const { return w < INLINE_WORDS ? inline_[w] : heap_[w - INLINE_WORDS]; }
+};
+
+class Validator {
+public:
+    Validator(const char *json, size_t length, bool validateUTF8)
+            : begin_(json), p_(json), end_(json + length), validateUTF8_(validateUTF8) {}
+
+    size_t offset() const { return p_ - begin_; }
+
+    JSONParseResult validate() {
+        parseWhitespace();
+        JSONParseResult ret = parseValue();
+        if (ret == PARSE_OK) {
+            parseWhitespace();
+            if (p_ != end_) ret = PARSE_ROOT_NOT_SINGULAR;
+        }
+        return ret;
+    }
+
+private:
+    const char *begin_;
+    const char *p_;
+    const char *end_;
+    bool validateUTF8_;
+
+    char peek() const { return p_ < end_ ? *p_ : '\0'; }
+
+    void parseWhitespace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) p_++;
+    }
+
+    // 用显式的括号栈代替递归，任意深的嵌套都不会耗尽调用栈
+    JSONParseResult parseValue() {
+        BracketStack stack;    // 尚未闭合的'['和'{'
+        while (true) {
+            // 此处应是一个值
+            if (p_ == end_) return PARSE_EXPECT_VALUE;
+            JSONParseResult ret;
+            switch (*p_) {
+                case 'n':
+                    ret = parseLiteral("null", 4);
+                    break;
+                case 't':
+                    ret = parseLiteral("true", 4);
+                    break;
+                case 'f':
+                    ret = parseLiteral("false", 5);
+                    break;
+                case '\"':
+                    ret = parseString();
+                    break;
+                case '[':
+                case '{': {
+                    char open = *p_++;
+                    parseWhitespace();
+                    if (peek() == (open == '[' ? ']' : '}')) {
+                        p_++;
+                        ret = PARSE_OK;
+                        break;
+                    }
+                    stack.push(open == '{');
+                    if (open == '{' && (ret = parseKey()) != PARSE_OK) return ret;
+                    continue;
+                }
+                default:
+                    ret = parseNumber();
+            }
+            if (ret != PARSE_OK) return ret;
+
+            // 一个值结束：逗号之后继续下一个值，闭括号则回到外层
+            while (true) {
+                if (stack.empty()) return PARSE_OK;
+                char open = stack.topIsObject() ? '{' : '[';
+                parseWhitespace();
+                if (peek() == ',') {
+                    p_++;
+                    parseWhitespace();
+                    if (open == '{' && (ret = parseKey()) != PARSE_OK) return ret;
+                    break;
+                }
+                if (peek() != (open == '[' ? ']' : '}'))
+                    return open == '[' ? PARSE_MISS_COMMA_OR_SQUARE_BRACKET : PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                p_++;
+                stack.pop();
+            }
+        }
+    }
+
+    // key和冒号，结束时停在值的开头
+    JSONParseResult parseKey() {
+        if (peek() != '\"') return PARSE_MISS_KEY;
+        const char *key = p_;
+        JSONParseResult ret = parseString();
+        if (ret != PARSE_OK) return ret;
+        bool empty = p_ - key == 2;
+        parseWhitespace();
+        if (peek() != ':') return PARSE_MISS_COLON;
+        if (empty) {
+            p_ = key;
+            return PARSE_MISS_KEY;
+        }
+        p_++;
+        parseWhitespace();
+        return PARSE_OK;
+    }
+
+    JSONParseResult parseLiteral(const char *literal, size_t size) {
+        if ((size_t) (end_ - p_) < size || memcmp(p_, literal, size) != 0) return PARSE_INVALID_VALUE;
+        p_ += size;
+        return PARSE_OK;
+    }
+
+    JSONParseResult parseNumber() {
+        bool tooBig;
+        const char *end = jsonScanNumber(p_, end_, tooBig);
+        if (!end) return PARSE_INVALID_VALUE;
+        if (tooBig) return PARSE_NUMBER_TOO_BIG;
+        p_ = end;
+        return PARSE_OK;
+    }
+
+    bool parseHex4(unsigned &u) {
+        u = 0;
+        for (int i = 0; i < 4; i++, p_++) {
+            int digit = jsonHexTable.value[(unsigned char) peek()];
+            if (digit < 0) return false;
+            u = (u << 4) | digit;
+        }
+        return true;
+    }
+
+    JSONParseResult parseString() {
+        p_++;
+        // 检查UTF-8时非ASCII字节也要停下来，逐个序列校验
+        unsigned char limit = validateUTF8_ ? 0x7f : 0xff;
+        while (true) {
+            while (p_ < end_ && *p_ != '\"' && *p_ != '\\' && (unsigned char) *p_ >= 0x20 &&
+                   (unsigned char) *p_ <= limit)
+                p_++;
+            if (p_ == end_) return PARSE_MISS_QUOTATION_MARK;
+            char ch = *p_;
+            if (ch == '\"') {
+                p_++;
+                return PARSE_OK;
+            }
+            if ((unsigned char) ch >= 0x80) {
+                int size = jsonUTF8SequenceLength(p_, end_);
+                if (size == 0) return PARSE_INVALID_UTF8;
+                p_ += size;
+                continue;
+            }
+            if (ch != '\\') return PARSE_INVALID_STRING_CHAR;
+            p_++;
+            switch (peek()) {
+                case '\"':
+                case '\\':
+                case '/':
+                case 'b':
+                case 'f':
+                case 'n':
+                case 'r':
+                case 't':
+                    p_++;
+                    break;
+                case 'u': {
+                    p_++;
+                    unsigned u;
+                    if (!parseHex4(u)) return PARSE_INVALID_UNICODE_HEX;
+                    if (u >= 0xd800 && u <= 0xdbff) {
+                        if (peek() != '\\') return PARSE_INVALID_UNICODE_SURROGATE;
+                        p_++;
+                        if (peek() != 'u') return PARSE_INVALID_UNICODE_SURROGATE;
+                        p_++;
+                        if (!parseHex4(u)) return PARSE_INVALID_UNICODE_HEX;
+                        if (u < 0xdc00 || u > 0xdfff) {
+                            p_ -= 6;
+                            return PARSE_INVALID_UNICODE_SURROGATE;
+                        }
+                    } else if (u >= 0xdc00 && u <= 0xdfff) {
+                        p_ -= 6;    // 单独的低代理项
+                        return PARSE_INVALID_UNICODE_SURROGATE;
+                    }
+                    break;
+                }
+                default:
+                    return PARSE_INVALID_STRING_ESCAPE;
+            }
+        }
+    }
+};
+
+}
+
+JSONParseResult MyJSON::validate(const char *json, size_t length, size_t *errorOffset, bool validateUTF8) {
+    Validator validator(json, length, validateUTF8);
+    JSONParseResult ret = validator.validate();
+    if (errorOffset) *errorOffset = ret == PARSE_OK ? length : validator.offset();
+    return ret;
+}
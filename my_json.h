@@ -5,12 +5,17 @@
 #ifndef MY_JSON_MY_JSON_H
 #define MY_JSON_MY_JSON_H
 
+#include <cstdint>
 #include <string>
 #include <cassert>
 #include <iostream>
 #include <vector>
-#include <stack>
 #include <map>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <initializer_list>
+#include <string_view>
 
 enum JSONType {
     JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT
@@ -30,23 +35,218 @@ enum JSONParseResult {
     PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
     PARSE_MISS_KEY,
     PARSE_MISS_COLON,
-    PARSE_MISS_COMMA_OR_CURLY_BRACKET
+    PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    PARSE_TYPE_MISMATCH,
+    PARSE_INVALID_UTF8,
+    PARSE_TOO_DEEP,
+    PARSE_IO_ERROR
 };
 
 enum JSONStringifyResult {
     STRINGIFY_OK
 };
 
+enum JSONStatsOp {
+    STATS_PARSE, STATS_STRINGIFY
+};
+
+// PHASE_STRING为字符串（含key）的解码/转义，PHASE_NUMBER为数字的扫描转换/输出，
+// PHASE_STRUCTURE为其余时间：括号、逗号、冒号、空白、true/false/null和存储的复用
+enum JSONStatsPhase {
+    PHASE_STRING, PHASE_NUMBER, PHASE_STRUCTURE
+};
+
+// 单次parse/jsonStringify的统计信息，仅在定义MY_JSON_STATS时收集
+struct JSONStats {
+    JSONStatsOp op;
+    int result;                         // JSONParseResult 或 JSONStringifyResult
+    size_t bytes;                       // parse读入 / stringify输出的字节数
+    size_t nodes[JSON_OBJECT + 1];      // 按JSONType统计的节点数
+    size_t maxDepth;                    // 根节点深度为1
+    size_t longestString;               // 解码后最长字符串（含key）的字节数
+    size_t escapes;                     // 转义序列个数
+    size_t allocs;                      // 需设置readAllocCounter
+    size_t allocBytes;
+    double seconds;
+    double phaseSeconds[PHASE_STRUCTURE + 1];   // 各阶段之和为seconds
+};
+
+// MyJSON::memoryUsage()的结果。map节点的大小按常见实现估算，不含malloc自身的开销；
+// 驻留表中的key属于JSONKeyTable，不计入
+struct JSONMemoryUsage {
+    size_t nodes[JSON_OBJECT + 1];      // 按JSONType统计的节点数
+    size_t bytes[JSON_OBJECT + 1];      // 各类型节点自身持有的堆内存
+    size_t stringBytes;                 // 字符串和数字原文
+    size_t keyBytes;                    // object的key
+    size_t containerBytes;              // 数组缓冲区和map节点，含其中元素的sizeof(MyJSON)
+    size_t slackBytes;                  // 已分配但未使用的容量，compact()可以释放
+    size_t total;                       // 根节点的sizeof(MyJSON)加上所有堆内存
+};
+
+struct JSONStatsHooks {
+    void (*report)(const JSONStats &) = nullptr;
+    // 可选，读取调用方自己维护的分配计数器（例如替换的operator new）
+    void (*readAllocCounter)(size_t &count, size_t &bytes) = nullptr;
+    // 每sampleRate次调用统计一次
+    unsigned sampleRate = 1;
+};
+
+// parse时只构建选中的key路径，其余值只做括号/引号配对扫描后跳过
+class JSONProjection {
+public:
+    JSONProjection() : nodes_(1) {}
+
+    JSONProjection(std::initializer_list<std::string> paths) : nodes_(1) {
+        for (auto &path: paths) add(path);
+    }
+
+    // 用'.'分隔的key路径；数组对路径透明，作用于每个元素
+    void add(const std::string &path);
+
+    void add(const std::vector<std::string> &keys);
+
+private:
+    friend class MyJSON;
+
+    struct Node {
+        bool all = false;       // 整个子树都需要
+        std::map<std::string, size_t, std::less<>> children;
+    };
+
+    std::vector<Node> nodes_;   // nodes_[0]为根
+};
+
+struct JSONSymbol {
+    std::string name;
+};
+
+// key驻留表：相同的key总是映射到同一个JSONSymbol。驻留只让多个文档共用key的存储，
+// object节点仍要逐个分配；符号上不保存哈希，查找object时也不用哈希。
+// 用它解析出的文档引用表中的符号，表必须比这些文档存活得更久。
+// threadSafe为false时只能在一个线程中使用；为true时查找共享读锁，插入新key时独占
+class JSONKeyTable {
+public:
+    explicit JSONKeyTable(bool threadSafe = false) : threadSafe_(threadSafe) {}
+
+    JSONKeyTable(const JSONKeyTable &) = delete;
+
+    JSONKeyTable &operator=(const JSONKeyTable &) = delete;
+
+    const JSONSymbol *intern(std::string_view key);
+
+    // 不存在时返回nullptr
+    const JSONSymbol *find(std::string_view key) const;
+
+    size_t size() const;
+
+    bool threadSafe() const { return threadSafe_; }
+
+private:
+    bool threadSafe_;
+    mutable std::shared_mutex mutex_;
+    // key指向symbol->name，unique_ptr保证rehash后地址不变
+    std::unordered_map<std::string_view, std::unique_ptr<JSONSymbol>> symbols_;
+
+    const JSONSymbol *findLocked(std::string_view key) const;
+};
+
+// object的key：普通字符串，或JSONKeyTable中的符号
+class JSONKey {
+public:
+    explicit JSONKey(std::string name) : name_(std::move(name)), symbol_(nullptr) {}
+
+    explicit JSONKey(const JSONSymbol *symbol) : symbol_(symbol) {}
+
+    const std::string &str() const { return symbol_ ? symbol_->name : name_; }
+
+    std::string_view view() const { return str(); }
+
+    const JSONSymbol *symbol() const { return symbol_; }
+
+    friend bool operator<(const JSONKey &a, const JSONKey &b) {
+        if (a.symbol_ && a.symbol_ == b.symbol_) return false;
+        return a.view() < b.view();
+    }
+
+    friend bool operator<(const JSONKey &a, std::string_view b) { return a.view() < b; }
+
+    friend bool operator<(std::string_view a, const JSONKey &b) { return a < b.view(); }
+
+private:
+    std::string name_;
+    const JSONSymbol *symbol_;
+};
+
+enum JSONNumberMode {
+    NUMBER_RAW,     // 保存原文，第一次读取时再转换
+    NUMBER_DOUBLE,  // 解析时转换为double，不保留原文
+    NUMBER_INT64    // 只接受int64范围内的整数，小数和指数返回PARSE_INVALID_VALUE
+};
+
+// 解析策略：每个实例只编译它需要的检查。
+// 模板实现在my_json.inl中，任意参数组合都可以直接使用
+template<bool Relaxed, bool ValidateUTF8, JSONNumberMode Numbers, size_t MaxDepth, bool Stats>
+struct JSONPolicy {
+    static constexpr bool relaxed = Relaxed;                // 允许注释和尾随逗号
+    static constexpr bool validateUTF8 = ValidateUTF8;
+    static constexpr JSONNumberMode numbers = Numbers;
+    static constexpr size_t maxDepth = MaxDepth;            // 数组和object的最大嵌套层数，0为不限制
+    static constexpr bool stats = Stats;                    // 定义MY_JSON_STATS时是否统计
+};
+
+// parse(json)的行为
+using JSONDefaultPolicy = JSONPolicy<false, false, NUMBER_RAW, 0, true>;
+// 不可信的输入：严格按RFC 8259，检查UTF-8并限制嵌套
+using JSONStrictPolicy = JSONPolicy<false, true, NUMBER_RAW, 512, true>;
+using JSONRelaxedPolicy = JSONPolicy<true, true, NUMBER_RAW, 512, true>;
+using JSONDoublePolicy = JSONPolicy<false, true, NUMBER_DOUBLE, 512, true>;
+using JSONInt64Policy = JSONPolicy<false, true, NUMBER_INT64, 512, true>;
+// 可信的内部输入：只做语法检查，不统计
+using JSONTrustedPolicy = JSONPolicy<false, false, NUMBER_RAW, 0, false>;
+
+struct JSONParseOptions {
+    // 字符串中的原始字节必须是合法UTF-8，否则返回PARSE_INVALID_UTF8。
+    // 按策略解析时由策略决定，忽略该项
+    bool validateUTF8 = false;
+    // 只构建选中的key路径
+    const JSONProjection *projection = nullptr;
+    // object的key驻留到该表中
+    JSONKeyTable *keys = nullptr;
+};
+
 class MyJSON {
 public:
     explicit MyJSON(JSONType type = JSON_NULL) : type_(type) {}
 
-    JSONParseResult parse(const char *);
+    // validateUTF8为true时，字符串中的原始字节必须是合法UTF-8，否则返回PARSE_INVALID_UTF8
+    JSONParseResult parse(const char *, bool validateUTF8 = false);
+
+    JSONParseResult parse(const char *, const JSONProjection &projection, bool validateUTF8 = false);
+
+    JSONParseResult parse(const char *, const JSONParseOptions &options);
+
+    // 按编译期策略解析，如parse<JSONStrictPolicy>(json)
+    template<class Policy>
+    JSONParseResult parse(const char *json, const JSONParseOptions &options = JSONParseOptions()) {
+        MyContext context;
+        return parseRoot<Policy>(context, json, options);
+    }
+
+    // 只检查语法，不构建树、不转换值；嵌套不超过4096层时不分配内存，更深时括号栈才在堆上扩展；失败时errorOffset为出错位置
+    static JSONParseResult validate(const char *json, size_t length, size_t *errorOffset = nullptr,
+                                    bool validateUTF8 = false);
 
     JSONType getType() { return type_; }
 
+    // 数字在解析时只保存原文，第一次读取时才转换
     double getNumber();
 
+    // 整数按原文直接转换，不经过double；超出范围时取边界值
+    int64_t getInt64();
+
+    // 解析得到的数字返回原文，否则返回%.17g格式
+    std::string getRawNumber();
+
     std::string getString();
 
     std::vector<MyJSON> getArray();
@@ -59,58 +259,113 @@ public:
 
     MyJSON getValueFromKey(std::string key);
 
-    void MyJSON::setValueToKey(std::string, MyJSON);
+    // 与按字符串查找相同，仍在有序map中做O(log n)次字符串比较；只有最终命中同一个符号时是指针比较
+    MyJSON getValueFromKey(const JSONSymbol *symbol);
+
+    void setValueToKey(std::string, MyJSON);
 
     bool operator==(const MyJSON &) const;
 
+    JSONMemoryUsage memoryUsage() const;
+
+    // 容器和字符串收缩到实际大小，短字符串放回对象内部，并释放复用存储时留下的空容器。
+    // relocate为true时按深度优先顺序复制整棵树再替换，使节点在堆上尽量相邻
+    void compact(bool relocate = false);
+
+    // 应在开始解析前设置；未定义MY_JSON_STATS时为空操作
+    static void setStatsHooks(const JSONStatsHooks &);
+
 private:
+    friend class JSONColumns;
+    friend class JSONParser;
 
     struct JSONValue {
         double nVal;
+        bool nDecoded;      // 为false时nVal尚未从sVal中的数字原文转换
         std::string sVal;
-        std::map<std::string, MyJSON> jVal;
+        std::map<JSONKey, MyJSON, std::less<>> jVal;
         std::vector<MyJSON> arrVal;
 
-        JSONValue() : nVal(0), sVal(""), jVal({}), arrVal({}) {}
+        JSONValue() : nVal(0), nDecoded(true), sVal(""), jVal({}), arrVal({}) {}
     };
 
     struct MyContext {
         const char *json;
-        std::stack<char> chStack;
-
-        MyContext() : json(nullptr), chStack(std::stack<char>()) {}
+        std::string key;        // 解码key的缓冲区，解析之间保留容量
+        const JSONProjection *projection;   // 为空时完整解析
+        size_t projectionNode;
+        JSONKeyTable *keys;
+        size_t nesting;         // 当前数组和object的嵌套层数
+        size_t growths;         // 本次解析中存储增长的次数：数组扩容、新的map节点、字符串扩容
+#ifdef MY_JSON_STATS
+        JSONStats *stats;
+        size_t depth;
+#endif
+
+        MyContext() : json(nullptr), projection(nullptr), projectionNode(0), keys(nullptr), nesting(0), growths(0)
+#ifdef MY_JSON_STATS
+                , stats(nullptr), depth(0)
+#endif
+        {}
     };
 
     JSONType type_;
     JSONValue value_;
 
+    // 按options.validateUTF8选择策略
+    JSONParseResult parseRoot(MyContext &, const char *, const JSONParseOptions &);
+
+    template<class Policy>
+    JSONParseResult parseRoot(MyContext &, const char *, const JSONParseOptions &);
+
+    double numberValue() const;
+
+    void addMemoryUsage(JSONMemoryUsage &) const;
+
+    template<class Policy>
     static void parseWhitespace(MyContext &);
 
-    static void encodeUTF8(MyContext &context, unsigned int u);
+    template<class Policy>
+    static JSONParseResult skipValue(MyContext &);
+
+    template<class Policy>
+    JSONParseResult parseProjectedKey(MyContext &, std::string &, size_t &child, bool &skip);
+
+    template<class Policy>
+    JSONParseResult parseInternedKey(MyContext &, const JSONSymbol *&);
 
     JSONParseResult parseNull(MyContext &);
 
+    template<class Policy>
     JSONParseResult parseValue(MyContext &);
 
+    template<class Policy>
+    JSONParseResult parseValueRaw(MyContext &);
+
     JSONParseResult parseTrue(MyContext &);
 
     JSONParseResult parseFalse(MyContext &);
 
     JSONParseResult parseValue(MyContext &, const char *, JSONType);
 
+    template<class Policy>
     JSONParseResult parseNumber(MyContext &);
 
+    template<class Policy>
     JSONParseResult parseString(MyContext &);
 
+    template<class Policy>
     JSONParseResult parseStringRaw(MyContext &, std::string &);
 
+    template<class Policy>
     JSONParseResult parseObject(MyContext &);
 
-    void setString(std::stack<char> &chStack, std::string &);
-
+    template<class Policy>
     JSONParseResult parseArray(MyContext &context);
 
 
+    JSONStringifyResult valueStringify(std::string &);
+
     JSONStringifyResult numberStringify(std::string &);
 
     JSONStringifyResult nullStringify(std::string &);
@@ -125,8 +380,44 @@ private:
 
     JSONStringifyResult objectStringify(std::string &sjson);
 
-    JSONStringifyResult stringStringifyRaw(std::string &sjson, const std::string &value);
+    JSONStringifyResult stringStringifyRaw(std::string &sjson, std::string_view value);
+};
+
+
+// 长期使用的解析器：保留key缓冲区和上一次解析得到的文档，
+// 下一次解析复用其中的数组、map节点和字符串容量。
+// 解析结构相近、大小相近的消息时，稳定后不再分配堆内存
+class JSONParser {
+public:
+    explicit JSONParser(const JSONParseOptions &options = JSONParseOptions()) : options_(options) {}
+
+    // 返回的文档在下一次parse()前有效
+    JSONParseResult parse(const char *json) { return document_.parseRoot(context_, json, options_); }
+
+    template<class Policy>
+    JSONParseResult parse(const char *json) { return document_.parseRoot<Policy>(context_, json, options_); }
+
+    MyJSON &document() { return document_; }
+
+    const JSONParseOptions &options() const { return options_; }
+
+    // 上一次parse()中存储增长的次数；保留的存储够用时为0。驻留表中新增的key不计入
+    size_t growths() const { return context_.growths; }
+
+    void setOptions(const JSONParseOptions &options) { options_ = options; }
+
+    // 释放保留的存储
+    void clear() {
+        document_ = MyJSON();
+        context_.key = std::string();
+    }
+
+private:
+    JSONParseOptions options_;
+    MyJSON document_;
+    MyJSON::MyContext context_;
 };
 
+#include "my_json.inl"
 
 #endif //MY_JSON_MY_JSON_H
@@ -0,0 +1,421 @@
+//
+// MyJSON按策略解析的模板实现，由my_json.h包含，任意JSONPolicy都能在使用处实例化
+//
+
+#ifndef MY_JSON_MY_JSON_INL
+#define MY_JSON_MY_JSON_INL
+
+#include "my_json_internal.h"
+
+template<class Policy>
+JSONParseResult MyJSON::parseRoot(MyContext &context, const char *json, const JSONParseOptions &options) {
+    context.json = json;
+    context.projection = options.projection && !options.projection->nodes_[0].all ? options.projection : nullptr;
+    context.projectionNode = 0;
+    context.keys = options.keys;
+    context.nesting = 0;
+    context.growths = 0;
+#ifdef MY_JSON_STATS
+    context.stats = nullptr;
+    context.depth = 0;
+    JSONStats stats;
+    std::chrono::steady_clock::time_point start;
+    if (Policy::stats && jsonStatsSampled()) {
+        start = jsonStatsBegin(stats, STATS_PARSE);
+        context.stats = &stats;
+    }
+#endif
+    type_ = JSON_NULL;
+    parseWhitespace<Policy>(context);
+    JSONParseResult ret = parseValue<Policy>(context);
+    if (ret == PARSE_OK) {
+        parseWhitespace<Policy>(context);
+        if (*context.json != '\0') {
+            type_ = JSON_NULL;
+            ret = PARSE_ROOT_NOT_SINGULAR;
+        }
+    }
+#ifdef MY_JSON_STATS
+    if (context.stats) {
+        stats.result = ret;
+        stats.bytes = context.json - json;
+        jsonStatsEnd(stats, start);
+    }
+#endif
+    return ret;
+}
+
+// 宽松模式下注释也当作空白；未闭合的块注释留给调用者报错
+template<class Policy>
+void MyJSON::parseWhitespace(MyContext &context) {
+    const char *p = context.json;
+    while (true) {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        }
+        if constexpr (Policy::relaxed) {
+            if (jsonIsComment(p)) {
+                if (const char *end = jsonSkipComment(p)) {
+                    p = end;
+                    continue;
+                }
+            }
+        }
+        break;
+    }
+    context.json = p;
+}
+
+// 只做括号和引号配对，不解码字符串、不转换数字、不检查被跳过内容的其他语法
+template<class Policy>
+JSONParseResult MyJSON::skipValue(MyContext &context) {
+    const char *p = context.json;
+    switch (*p) {
+        case '\0':
+            return PARSE_EXPECT_VALUE;
+        case '"':
+            p = jsonSkipString(p);
+            if (!p) return PARSE_MISS_QUOTATION_MARK;
+            break;
+        case '[':
+        case '{': {
+            size_t depth = 0;
+            do {
+                switch (*p) {
+                    case '"':
+                        p = jsonSkipString(p);
+                        if (!p) return PARSE_MISS_QUOTATION_MARK;
+                        continue;
+                    case '[':
+                    case '{':
+                        depth++;
+                        break;
+                    case ']':
+                    case '}':
+                        depth--;
+                        break;
+                    case '/':
+                        // 注释中的引号和括号不参与配对
+                        if constexpr (Policy::relaxed) {
+                            if (jsonIsComment(p)) {
+                                p = jsonSkipComment(p);
+                                if (!p) break;
+                                continue;
+                            }
+                        }
+                        break;
+                }
+                if (!p || *p == '\0') {
+                    return *context.json == '[' ? PARSE_MISS_COMMA_OR_SQUARE_BRACKET
+                                                : PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                }
+                p++;
+            } while (depth);
+            break;
+        }
+        default: {
+            // 数字或true/false/null
+            while (*p != '\0' && *p != ',' && *p != ']' && *p != '}' &&
+                   *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && !(Policy::relaxed && *p == '/'))
+                p++;
+            if (p == context.json) return PARSE_INVALID_VALUE;
+        }
+    }
+    context.json = p;
+    return PARSE_OK;
+}
+
+template<class Policy>
+JSONParseResult MyJSON::parseValue(MyContext &context) {
+#ifdef MY_JSON_STATS
+    if (Policy::stats && context.stats) {
+        if (++context.depth > context.stats->maxDepth) context.stats->maxDepth = context.depth;
+        JSONParseResult ret = parseValueRaw<Policy>(context);
+        context.depth--;
+        if (ret == PARSE_OK) context.stats->nodes[type_]++;
+        return ret;
+    }
+#endif
+    return parseValueRaw<Policy>(context);
+}
+
+template<class Policy>
+JSONParseResult MyJSON::parseValueRaw(MyContext &context) {
+    // 容器留给同类型的值复用，其他类型时释放其中的元素
+    char ch = *context.json;
+    if (ch != '[') value_.arrVal.clear();
+    if (ch != '{') value_.jVal.clear();
+    switch (ch) {
+        case 'n':
+            return parseNull(context);
+        case 't':
+            return parseTrue(context);
+        case 'f':
+            return parseFalse(context);
+        case '\"':
+            return parseString<Policy>(context);
+        case '[':
+        case '{': {
+            if constexpr (Policy::maxDepth == 0) {
+                return ch == '[' ? parseArray<Policy>(context) : parseObject<Policy>(context);
+            } else {
+                if (context.nesting == Policy::maxDepth) return PARSE_TOO_DEEP;
+                context.nesting++;
+                JSONParseResult ret = ch == '[' ? parseArray<Policy>(context) : parseObject<Policy>(context);
+                context.nesting--;
+                return ret;
+            }
+        }
+        case '\0':
+            return PARSE_EXPECT_VALUE;
+        default:
+            return parseNumber<Policy>(context);
+    }
+}
+
+// NUMBER_RAW和NUMBER_INT64只保存原文，第一次getNumber()时再转换；NUMBER_DOUBLE立即转换
+template<class Policy>
+JSONParseResult MyJSON::parseNumber(MyContext &context) {
+#ifdef MY_JSON_STATS
+    JSONStatsTimer timer(Policy::stats ? context.stats : nullptr, PHASE_NUMBER);
+#endif
+    bool tooBig;
+    const char *p;
+    if constexpr (Policy::numbers == NUMBER_INT64) p = jsonScanInt64(context.json, tooBig);
+    else p = jsonScanNumber(context.json, nullptr, tooBig);
+    if (!p) return PARSE_INVALID_VALUE;
+    if (tooBig) return PARSE_NUMBER_TOO_BIG;
+    if constexpr (Policy::numbers == NUMBER_DOUBLE) {
+        value_.nVal = strtod(context.json, nullptr);
+        value_.nDecoded = true;
+        value_.sVal.clear();
+    } else {
+        size_t capacity = value_.sVal.capacity();
+        value_.sVal.assign(context.json, p - context.json);
+        if (value_.sVal.capacity() != capacity) context.growths++;
+        value_.nDecoded = false;
+    }
+    context.json = p;
+    type_ = JSONType::JSON_NUMBER;
+    return PARSE_OK;
+}
+
+// 直接解码到value中，复用value已有的容量
+template<class Policy>
+JSONParseResult MyJSON::parseStringRaw(MyJSON::MyContext &context, std::string &value) {
+    assert(*context.json == '\"');
+    const char *p = context.json + 1;
+    size_t *escapes = nullptr;
+#ifdef MY_JSON_STATS
+    JSONStatsTimer timer(Policy::stats ? context.stats : nullptr, PHASE_STRING);
+    if (Policy::stats && context.stats) escapes = &context.stats->escapes;
+#endif
+    size_t capacity = value.capacity();
+    value.clear();
+    JSONParseResult ret = jsonDecodeString<Policy::validateUTF8>(p, value, escapes);
+    if (value.capacity() != capacity) context.growths++;
+    if (ret != PARSE_OK) return ret;
+    context.json = p;
+#ifdef MY_JSON_STATS
+    if (Policy::stats && context.stats && value.size() > context.stats->longestString)
+        context.stats->longestString = value.size();
+#endif
+    return PARSE_OK;
+}
+
+template<class Policy>
+JSONParseResult MyJSON::parseString(MyContext &context) {
+    auto ret = parseStringRaw<Policy>(context, value_.sVal);
+    if (ret == PARSE_OK) {
+        type_ = JSON_STRING;
+    }
+    return ret;
+}
+
+// 依次解析到已有的元素中，复用上一次解析留下的存储
+template<class Policy>
+JSONParseResult MyJSON::parseArray(MyContext &context) {
+    assert(*context.json == '[');
+    context.json++;
+    JSONParseResult ret = PARSE_OK;
+    parseWhitespace<Policy>(context);
+    size_t size = 0;
+    if (*context.json == ']') {
+        context.json++;
+        value_.arrVal.clear();
+        type_ = JSON_ARRAY;
+        return PARSE_OK;
+    }
+    while (true) {
+        if (size == value_.arrVal.size()) {
+            if (size == value_.arrVal.capacity()) context.growths++;
+            value_.arrVal.emplace_back();
+        }
+        ret = value_.arrVal[size++].parseValue<Policy>(context);
+        parseWhitespace<Policy>(context);
+        if (ret != PARSE_OK) {
+            return ret;
+        }
+        if (*context.json == ',') {
+            context.json++;
+            parseWhitespace<Policy>(context);
+            if (!Policy::relaxed || *context.json != ']') continue;
+        }
+        if (*context.json == ']') {
+            context.json++;
+            value_.arrVal.erase(value_.arrVal.begin() + size, value_.arrVal.end());
+            type_ = JSON_ARRAY;
+            return PARSE_OK;
+        } else
+            return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+    }
+}
+
+// 上一次解析留下的同名成员连同map节点一起复用
+template<class Policy>
+JSONParseResult MyJSON::parseObject(MyJSON::MyContext &context) {
+    assert(*context.json == '{');
+    context.json++;
+    JSONParseResult ret = PARSE_OK;
+    parseWhitespace<Policy>(context);
+    auto old = std::move(value_.jVal);
+    value_.jVal.clear();
+    if (*context.json == '}') {
+        context.json++;
+        type_ = JSON_OBJECT;
+        return ret;
+    }
+    std::string &key = context.key;
+    while (true) {
+        // 解析key
+        if (*context.json != '"') return PARSE_MISS_KEY;
+        size_t child = 0;
+        bool skip = false;
+        const JSONSymbol *symbol = nullptr;
+        if (context.projection) ret = parseProjectedKey<Policy>(context, key, child, skip);
+        else if (context.keys) ret = parseInternedKey<Policy>(context, symbol);
+        else ret = parseStringRaw<Policy>(context, key);
+        if (ret != PARSE_OK) break;
+
+        // 冒号
+        parseWhitespace<Policy>(context);
+        if (*context.json != ':') return PARSE_MISS_COLON;
+        context.json++;
+        parseWhitespace<Policy>(context);
+
+        // 解析value
+        if (skip) {
+            ret = skipValue<Policy>(context);
+            if (ret != PARSE_OK) break;
+        } else {
+            if (symbol ? symbol->name.empty() : key.empty()) return PARSE_MISS_KEY;
+            if (!symbol && context.keys) symbol = context.keys->intern(key);
+            std::string_view name = symbol ? std::string_view(symbol->name) : std::string_view(key);
+            // 解析value会覆盖context.key，先取得成员
+            MyJSON *member;
+            auto iter = old.find(name);
+            if (iter != old.end()) {
+                auto node = old.extract(iter);
+                if (symbol && node.key().symbol() != symbol) node.key() = JSONKey(symbol);
+                member = &value_.jVal.insert(std::move(node)).position->second;
+            } else {
+                // 重复的key以最后一个为准
+                iter = value_.jVal.find(name);
+                if (iter != value_.jVal.end()) member = &iter->second;
+                else {
+                    context.growths++;
+                    if (symbol) member = &value_.jVal.emplace(JSONKey(symbol), MyJSON()).first->second;
+                    else member = &value_.jVal.emplace(JSONKey(key), MyJSON()).first->second;
+                }
+            }
+            const JSONProjection *projection = context.projection;
+            size_t parent = context.projectionNode;
+            if (projection) {
+                if (projection->nodes_[child].all) context.projection = nullptr;
+                else context.projectionNode = child;
+            }
+            ret = member->parseValue<Policy>(context);
+            context.projection = projection;
+            context.projectionNode = parent;
+            if (ret != PARSE_OK) break;
+        }
+        parseWhitespace<Policy>(context);
+
+        // 是否又下一个键值对
+        if (*context.json == ',') {
+            context.json++;
+            parseWhitespace<Policy>(context);
+            if (!Policy::relaxed || *context.json != '}') continue;
+        }
+        if (*context.json == '}') {
+            // 该object解析完了
+            context.json++;
+            type_ = JSON_OBJECT;
+            return PARSE_OK;
+        } else {
+            return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+    }
+
+    return ret;
+}
+
+// 投影解析时的key：不含转义的key直接用原文查找，未选中的key不解码
+template<class Policy>
+JSONParseResult MyJSON::parseProjectedKey(MyContext &context, std::string &key, size_t &child, bool &skip) {
+    const auto &children = context.projection->nodes_[context.projectionNode].children;
+    const char *start = context.json + 1;
+    const char *p = start;
+    while (*p != '"' && *p != '\\' && (unsigned char) *p >= 0x20) p++;
+    decltype(children.begin()) iter;
+    if (*p == '"') {
+        context.json = p + 1;
+        if (p == start) {
+            // 空key和不投影时一样，在冒号之后报PARSE_MISS_KEY
+            key.clear();
+            skip = false;
+            return PARSE_OK;
+        }
+        if (Policy::validateUTF8 && jsonFindInvalidUTF8(start, p) != p) return PARSE_INVALID_UTF8;
+        iter = children.find(std::string_view(start, p - start));
+        if (iter != children.end()) {
+            size_t capacity = key.capacity();
+            key.assign(start, p - start);
+            if (key.capacity() != capacity) context.growths++;
+        }
+    } else {
+        JSONParseResult ret = parseStringRaw<Policy>(context, key);
+        if (ret != PARSE_OK) return ret;
+        iter = children.find(key);
+    }
+    skip = iter == children.end();
+    if (!skip) child = iter->second;
+    return PARSE_OK;
+}
+
+// 不含转义的key直接用原文查找驻留表，不解码
+template<class Policy>
+JSONParseResult MyJSON::parseInternedKey(MyContext &context, const JSONSymbol *&symbol) {
+    const char *start = context.json + 1;
+    const char *p = start;
+    while (*p != '"' && *p != '\\' && (unsigned char) *p >= 0x20) p++;
+    if (*p == '"') {
+        if (Policy::validateUTF8 && jsonFindInvalidUTF8(start, p) != p) return PARSE_INVALID_UTF8;
+        symbol = context.keys->intern(std::string_view(start, p - start));
+        context.json = p + 1;
+        return PARSE_OK;
+    }
+    JSONParseResult ret = parseStringRaw<Policy>(context, context.key);
+    if (ret == PARSE_OK) symbol = context.keys->intern(context.key);
+    return ret;
+}
+
+// 预定义的策略已在my_json.cpp中实例化
+extern template JSONParseResult MyJSON::parseRoot<JSONDefaultPolicy>(MyContext &, const char *, const JSONParseOptions &);
+extern template JSONParseResult MyJSON::parseRoot<JSONStrictPolicy>(MyContext &, const char *, const JSONParseOptions &);
+extern template JSONParseResult MyJSON::parseRoot<JSONRelaxedPolicy>(MyContext &, const char *, const JSONParseOptions &);
+extern template JSONParseResult MyJSON::parseRoot<JSONTrustedPolicy>(MyContext &, const char *, const JSONParseOptions &);
+extern template JSONParseResult MyJSON::parseRoot<JSONDoublePolicy>(MyContext &, const char *, const JSONParseOptions &);
+extern template JSONParseResult MyJSON::parseRoot<JSONInt64Policy>(MyContext &, const char *, const JSONParseOptions &);
+
+#endif //MY_JSON_MY_JSON_INL
@@ -0,0 +1,527 @@
+//
+// 不经过MyJSON树，直接在JSON文本和C++结构体之间转换
+//
+// 支持: bool、整数、浮点数、std::string、std::vector<T>、std::optional<T>，
+// 以及通过MY_JSON_BINDING声明了字段表的结构体:
+//
+//     struct Point { double x; double y; std::optional<std::string> name; };
+//     MY_JSON_BINDING(Point, MY_JSON_FIELD(Point, x), MY_JSON_FIELD(Point, y), MY_JSON_FIELD(Point, name))
+//
+//     Point point;
+//     jsonParse("{\"x\":1,\"y\":2}", point);     // 第三个参数为true时检查UTF-8
+//     std::string json;
+//     jsonStringify(point, json);
+//
+// 字段表在编译期按(长度, 首字节)排好序，解析key时只有长度和首字节都相同的字段才比较内容。
+// 未声明的key会被跳过，缺失的字段保持原值。
+//
+
+#ifndef MY_JSON_MY_JSON_BIND_H
+#define MY_JSON_MY_JSON_BIND_H
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "my_json.h"
+#include "my_json_internal.h"
+
+template<typename Class, typename Member>
+struct JSONField {
+    const char *name;
+    size_t length;
+    Member Class::*member;
+};
+
+template<typename Class, typename Member, size_t N>
+constexpr JSONField<Class, Member> jsonField(const char (&name)[N], Member Class::*member) {
+    return {name, N - 1, member};
+}
+
+// 结构体的字段表，由MY_JSON_BINDING特化
+template<typename T>
+struct JSONBinding;
+
+#define MY_JSON_FIELD(Class, field) jsonField(#field, &Class::field)
+
+#define MY_JSON_BINDING(Class, ...)\
+    template<>\
+    struct JSONBinding<Class> {\
+        static constexpr auto fields = std::make_tuple(__VA_ARGS__);\
+    };
+
+struct JSONFieldKey {
+    const char *name;
+    size_t length;
+    size_t index;   // 在字段表中的位置
+};
+
+// 按(长度, 首字节)排序的字段表，编译期生成
+template<typename T>
+struct JSONFieldIndex {
+    static constexpr size_t size = std::tuple_size_v<std::remove_const_t<decltype(JSONBinding<T>::fields)>>;
+
+    static constexpr bool before(const JSONFieldKey &a, const JSONFieldKey &b) {
+        if (a.length != b.length) return a.length < b.length;
+        return (unsigned char) a.name[0] < (unsigned char) b.name[0];
+    }
+
+    template<size_t... I>
+    static constexpr std::array<JSONFieldKey, size> build(std::index_sequence<I...>) {
+        std::array<JSONFieldKey, size> keys{
+                JSONFieldKey{std::get<I>(JSONBinding<T>::fields).name, std::get<I>(JSONBinding<T>::fields).length, I}...};
+        for (size_t i = 1; i < size; i++) {
+            for (size_t j = i; j > 0 && before(keys[j], keys[j - 1]); j--) {
+                JSONFieldKey key = keys[j];
+                keys[j] = keys[j - 1];
+                keys[j - 1] = key;
+            }
+        }
+        return keys;
+    }
+
+    static constexpr std::array<JSONFieldKey, size> keys = build(std::make_index_sequence<size>());
+
+    // 返回字段在字段表中的位置，未声明的key返回size
+    static size_t find(const char *key, size_t length) {
+        for (const JSONFieldKey &field: keys) {
+            if (field.length < length) continue;
+            if (field.length > length) break;
+            if (field.name[0] == key[0] && memcmp(field.name, key, length) == 0) return field.index;
+        }
+        return size;
+    }
+};
+
+template<typename T, typename = void>
+struct hasJSONBinding : std::false_type {
+};
+
+template<typename T>
+struct hasJSONBinding<T, std::void_t<decltype(JSONBinding<T>::fields)>> : std::true_type {
+};
+
+template<typename T>
+struct isJSONVector : std::false_type {
+};
+
+template<typename T>
+struct isJSONVector<std::vector<T>> : std::true_type {
+};
+
+template<typename T>
+struct isJSONOptional : std::false_type {
+};
+
+template<typename T>
+struct isJSONOptional<std::optional<T>> : std::true_type {
+};
+
+class JSONBindReader {
+public:
+    explicit JSONBindReader(const char *json, bool validateUTF8 = false) : p_(json), validateUTF8_(validateUTF8) {}
+
+    const char *position() const { return p_; }
+
+    char peek() const { return *p_; }
+
+    void advance() { p_++; }
+
+    void parseWhitespace() {
+        while (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r') p_++;
+    }
+
+    template<typename T>
+    JSONParseResult read(T &value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            return readBool(value);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return readNumber(value);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            if (*p_ != '"') return typeMismatch();
+            value.clear();
+            return readString(value);
+        } else if constexpr (isJSONOptional<T>::value) {
+            if (*p_ == 'n') {
+                value.reset();
+                return readLiteral("null");
+            }
+            if (!value) value.emplace();
+            return read(*value);
+        } else if constexpr (isJSONVector<T>::value) {
+            return readArray(value);
+        } else {
+            static_assert(hasJSONBinding<T>::value, "type has no MY_JSON_BINDING");
+            return readObject(value);
+        }
+    }
+
+    // 解码字符串并追加到value，*p_必须是'"'
+    JSONParseResult readString(std::string &value) {
+        const char *p = p_ + 1;
+        JSONParseResult ret = validateUTF8_ ? jsonDecodeString<true>(p, value) : jsonDecodeString<false>(p, value);
+        if (ret == PARSE_OK) p_ = p;
+        return ret;
+    }
+
+    // 读取key；不含转义时直接引用原文，不复制。key在下一次readKey/skipValue前有效
+    JSONParseResult readKey(const char *&key, size_t &length) {
+        const char *start = p_ + 1;
+        const char *p = start;
+        while (*p != '"' && *p != '\\' && (unsigned char) *p >= 0x20) p++;
+        if (*p == '"') {
+            if (validateUTF8_ && jsonFindInvalidUTF8(start, p) != p) return PARSE_INVALID_UTF8;
+            key = start;
+            length = p - start;
+            p_ = p + 1;
+            return PARSE_OK;
+        }
+        scratch_.clear();
+        JSONParseResult ret = readString(scratch_);
+        key = scratch_.data();
+        length = scratch_.size();
+        return ret;
+    }
+
+    // 跳过一个值，完整检查语法
+    JSONParseResult skipValue() {
+        switch (*p_) {
+            case 'n':
+                return readLiteral("null");
+            case 't':
+                return readLiteral("true");
+            case 'f':
+                return readLiteral("false");
+            case '"': {
+                scratch_.clear();
+                return readString(scratch_);
+            }
+            case '[': {
+                p_++;
+                parseWhitespace();
+                if (*p_ == ']') {
+                    p_++;
+                    return PARSE_OK;
+                }
+                while (true) {
+                    JSONParseResult ret = skipValue();
+                    if (ret != PARSE_OK) return ret;
+                    parseWhitespace();
+                    if (*p_ == ',') {
+                        p_++;
+                        parseWhitespace();
+                    } else if (*p_ == ']') {
+                        p_++;
+                        return PARSE_OK;
+                    } else {
+                        return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                    }
+                }
+            }
+            case '{': {
+                p_++;
+                parseWhitespace();
+                if (*p_ == '}') {
+                    p_++;
+                    return PARSE_OK;
+                }
+                while (true) {
+                    if (*p_ != '"') return PARSE_MISS_KEY;
+                    const char *key;
+                    size_t length;
+                    JSONParseResult ret = readKey(key, length);
+                    if (ret != PARSE_OK) return ret;
+                    parseWhitespace();
+                    if (*p_ != ':') return PARSE_MISS_COLON;
+                    p_++;
+                    parseWhitespace();
+                    ret = skipValue();
+                    if (ret != PARSE_OK) return ret;
+                    parseWhitespace();
+                    if (*p_ == ',') {
+                        p_++;
+                        parseWhitespace();
+                    } else if (*p_ == '}') {
+                        p_++;
+                        return PARSE_OK;
+                    } else {
+                        return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                    }
+                }
+            }
+            case '\0':
+                return PARSE_EXPECT_VALUE;
+            default: {
+                double d;
+                return readNumber(d);
+            }
+        }
+    }
+
+private:
+    const char *p_;
+    bool validateUTF8_;
+    std::string scratch_;
+
+    JSONParseResult typeMismatch() {
+        return *p_ == '\0' ? PARSE_EXPECT_VALUE : PARSE_TYPE_MISMATCH;
+    }
+
+    JSONParseResult readLiteral(const char *literal) {
+        size_t size = strlen(literal);
+        if (strncmp(p_, literal, size) != 0) return PARSE_INVALID_VALUE;
+        p_ += size;
+        return PARSE_OK;
+    }
+
+    JSONParseResult readBool(bool &value) {
+        if (*p_ == 't') {
+            value = true;
+            return readLiteral("true");
+        }
+        if (*p_ == 'f') {
+            value = false;
+            return readLiteral("false");
+        }
+        return typeMismatch();
+    }
+
+    template<typename T>
+    JSONParseResult readNumber(T &value) {
+        if (*p_ != '-' && !jsonIsDigit(*p_)) {
+            return *p_ == '\0' || *p_ == '"' || *p_ == '[' || *p_ == '{' || *p_ == 't' || *p_ == 'f' || *p_ == 'n'
+                   ? typeMismatch() : PARSE_INVALID_VALUE;
+        }
+        bool tooBig;
+        const char *end = jsonScanNumber(p_, nullptr, tooBig);
+        if (!end) return PARSE_INVALID_VALUE;
+        if constexpr (std::is_floating_point_v<T>) {
+            if (tooBig) return PARSE_NUMBER_TOO_BIG;
+            double d = strtod(p_, nullptr);
+            // float等比double窄的类型，超出其最大有限值时同样报错而不是得到inf
+            if (std::fabs(d) > (double) std::numeric_limits<T>::max()) return PARSE_NUMBER_TOO_BIG;
+            value = (T) d;
+        } else {
+            for (const char *p = p_; p < end; p++) {
+                if (*p == '.' || *p == 'e' || *p == 'E') return PARSE_TYPE_MISMATCH;
+            }
+            errno = 0;
+            if constexpr (std::is_signed_v<T>) {
+                long long n = strtoll(p_, nullptr, 10);
+                if (errno == ERANGE || n < (long long) std::numeric_limits<T>::min() ||
+                    n > (long long) std::numeric_limits<T>::max())
+                    return PARSE_NUMBER_TOO_BIG;
+                value = (T) n;
+            } else {
+                if (*p_ == '-') return PARSE_TYPE_MISMATCH;
+                unsigned long long n = strtoull(p_, nullptr, 10);
+                if (errno == ERANGE || n > (unsigned long long) std::numeric_limits<T>::max())
+                    return PARSE_NUMBER_TOO_BIG;
+                value = (T) n;
+            }
+        }
+        p_ = end;
+        return PARSE_OK;
+    }
+
+    template<typename T>
+    JSONParseResult readArray(std::vector<T> &value) {
+        if (*p_ != '[') return typeMismatch();
+        p_++;
+        value.clear();
+        parseWhitespace();
+        if (*p_ == ']') {
+            p_++;
+            return PARSE_OK;
+        }
+        while (true) {
+            value.emplace_back();
+            JSONParseResult ret = read(value.back());
+            if (ret != PARSE_OK) return ret;
+            parseWhitespace();
+            if (*p_ == ',') {
+                p_++;
+                parseWhitespace();
+            } else if (*p_ == ']') {
+                p_++;
+                return PARSE_OK;
+            } else {
+                return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            }
+        }
+    }
+
+    template<typename T, size_t I>
+    static JSONParseResult readFieldAt(JSONBindReader &reader, T &object) {
+        return reader.read(object.*(std::get<I>(JSONBinding<T>::fields).member));
+    }
+
+    // 按字段下标查表分派
+    template<typename T, size_t... I>
+    JSONParseResult readField(T &object, size_t index, std::index_sequence<I...>) {
+        using Reader = JSONParseResult (*)(JSONBindReader &, T &);
+        static constexpr Reader readers[] = {&readFieldAt<T, I>...};
+        return readers[index](*this, object);
+    }
+
+    template<typename T>
+    JSONParseResult readObject(T &value) {
+        if (*p_ != '{') return typeMismatch();
+        p_++;
+        parseWhitespace();
+        if (*p_ == '}') {
+            p_++;
+            return PARSE_OK;
+        }
+        while (true) {
+            // 解析key
+            if (*p_ != '"') return PARSE_MISS_KEY;
+            const char *key;
+            size_t length;
+            JSONParseResult ret = readKey(key, length);
+            if (ret != PARSE_OK) return ret;
+
+            // 冒号
+            parseWhitespace();
+            if (*p_ != ':') return PARSE_MISS_COLON;
+            if (length == 0) return PARSE_MISS_KEY;
+            p_++;
+            parseWhitespace();
+
+            // 按字段表分派，未声明的key跳过
+            size_t index = JSONFieldIndex<T>::find(key, length);
+            if (index < JSONFieldIndex<T>::size)
+                ret = readField(value, index, std::make_index_sequence<JSONFieldIndex<T>::size>());
+            else
+                ret = skipValue();
+            if (ret != PARSE_OK) return ret;
+            parseWhitespace();
+
+            if (*p_ == ',') {
+                p_++;
+                parseWhitespace();
+            } else if (*p_ == '}') {
+                p_++;
+                return PARSE_OK;
+            } else {
+                return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            }
+        }
+    }
+};
+
+class JSONBindWriter {
+public:
+    explicit JSONBindWriter(std::string &json) : json_(json) {}
+
+    template<typename T>
+    void write(const T &value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            json_ += value ? "true" : "false";
+        } else if constexpr (std::is_floating_point_v<T>) {
+            char buffer[32];
+            sprintf(buffer, "%.17g", (double) value);
+            json_ += buffer;
+        } else if constexpr (std::is_integral_v<T>) {
+            json_ += std::to_string(value);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            writeString(value.data(), value.size());
+        } else if constexpr (isJSONOptional<T>::value) {
+            if (value) write(*value);
+            else json_ += "null";
+        } else if constexpr (isJSONVector<T>::value) {
+            json_ += '[';
+            for (size_t i = 0; i < value.size(); i++) {
+                if (i) json_ += ',';
+                write(value[i]);
+            }
+            json_ += ']';
+        } else {
+            static_assert(hasJSONBinding<T>::value, "type has no MY_JSON_BINDING");
+            json_ += '{';
+            bool first = true;
+            std::apply([&](const auto &... fields) {
+                (writeField(value, fields, first), ...);
+            }, JSONBinding<T>::fields);
+            json_ += '}';
+        }
+    }
+
+private:
+    std::string &json_;
+
+    void writeString(const char *s, size_t length) {
+        json_ += '"';
+        for (size_t i = 0; i < length; i++) {
+            char ch = s[i];
+            switch (ch) {
+                case '"':
+                    json_ += "\\\"";
+                    break;
+                case '\\':
+                    json_ += "\\\\";
+                    break;
+                case '\b':
+                    json_ += "\\b";
+                    break;
+                case '\f':
+                    json_ += "\\f";
+                    break;
+                case '\n':
+                    json_ += "\\n";
+                    break;
+                case '\r':
+                    json_ += "\\r";
+                    break;
+                case '\t':
+                    json_ += "\\t";
+                    break;
+                default:
+                    if ((unsigned char) ch < 0x20) {
+                        char buffer[7];
+                        sprintf(buffer, "\\u%04X", (unsigned char) ch);
+                        json_ += buffer;
+                    } else
+                        json_ += ch;
+            }
+        }
+        json_ += '"';
+    }
+
+    template<typename T, typename Field>
+    void writeField(const T &object, const Field &field, bool &first) {
+        if (!first) json_ += ',';
+        first = false;
+        writeString(field.name, field.length);
+        json_ += ':';
+        write(object.*(field.member));
+    }
+};
+
+template<typename T>
+JSONParseResult jsonParse(const char *json, T &value, bool validateUTF8 = false) {
+    JSONBindReader reader(json, validateUTF8);
+    reader.parseWhitespace();
+    JSONParseResult ret = reader.read(value);
+    if (ret == PARSE_OK) {
+        reader.parseWhitespace();
+        if (*reader.position() != '\0') ret = PARSE_ROOT_NOT_SINGULAR;
+    }
+    return ret;
+}
+
+template<typename T>
+JSONStringifyResult jsonStringify(const T &value, std::string &json) {
+    JSONBindWriter(json).write(value);
+    return STRINGIFY_OK;
+}
+
+#endif //MY_JSON_MY_JSON_BIND_H
@@ -0,0 +1,251 @@
+//
+// 按列提取同构对象数组
+//
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include "my_json_columns.h"
+#include "my_json_bind.h"
+
+void JSONColumn::clear() {
+    doubles.clear();
+    ints.clear();
+    chars.clear();
+    offsets.assign(1, 0);
+    validity.clear();
+}
+
+void JSONColumn::appendNull(size_t row) {
+    if (row % 8 == 0) validity.push_back(0);
+    switch (type) {
+        case COLUMN_DOUBLE:
+            doubles.push_back(0);
+            break;
+        case COLUMN_INT64:
+            ints.push_back(0);
+            break;
+        case COLUMN_STRING:
+            offsets.push_back(chars.size());
+            break;
+    }
+}
+
+void JSONColumn::setValid(size_t row) {
+    validity[row / 8] |= (uint8_t) (1u << (row % 8));
+}
+
+void JSONColumns::addColumn(const std::string &name, JSONColumnType type) {
+    index_[name] = columns_.size();
+    columns_.emplace_back(name, type);
+    seen_.push_back(false);
+    clear();
+}
+
+void JSONColumns::clear() {
+    for (auto &column: columns_) column.clear();
+    rows_ = 0;
+}
+
+// 补齐本行未出现的列
+void JSONColumns::endRow() {
+    for (size_t i = 0; i < columns_.size(); i++) {
+        if (!seen_[i]) columns_[i].appendNull(rows_);
+        seen_[i] = false;
+    }
+    rows_++;
+}
+
+static JSONParseResult parseCell(JSONBindReader &reader, JSONColumn &column, size_t row) {
+    if (reader.peek() == 'n') {
+        column.appendNull(row);
+        return reader.skipValue();
+    }
+    JSONParseResult ret = PARSE_OK;
+    switch (column.type) {
+        case COLUMN_DOUBLE: {
+            double d = 0;
+            ret = reader.read(d);
+            column.doubles.push_back(d);
+            break;
+        }
+        case COLUMN_INT64: {
+            int64_t n = 0;
+            ret = reader.read(n);
+            column.ints.push_back(n);
+            break;
+        }
+        case COLUMN_STRING:
+            if (reader.peek() != '"') return reader.peek() == '\0' ? PARSE_EXPECT_VALUE : PARSE_TYPE_MISMATCH;
+            // 直接解码到共享的字符缓冲区
+            ret = reader.readString(column.chars);
+            column.offsets.push_back(column.chars.size());
+            break;
+    }
+    if (row % 8 == 0) column.validity.push_back(0);
+    column.setValid(row);
+    return ret;
+}
+
+JSONParseResult JSONColumns::parse(const char *json) {
+    clear();
+    JSONBindReader reader(json);
+    JSONParseResult ret = PARSE_OK;
+    reader.parseWhitespace();
+    if (reader.peek() != '[') return reader.peek() == '\0' ? PARSE_EXPECT_VALUE : PARSE_TYPE_MISMATCH;
+    reader.advance();
+    reader.parseWhitespace();
+    if (reader.peek() == ']') {
+        reader.advance();
+    } else {
+        while (true) {
+            if (reader.peek() != '{') {
+                ret = reader.peek() == '\0' ? PARSE_EXPECT_VALUE : PARSE_TYPE_MISMATCH;
+                break;
+            }
+            reader.advance();
+            reader.parseWhitespace();
+            if (reader.peek() == '}') {
+                reader.advance();
+            } else {
+                while (true) {
+                    // 解析key
+                    if (reader.peek() != '"') {
+                        ret = PARSE_MISS_KEY;
+                        break;
+                    }
+                    const char *key;
+                    size_t length;
+                    ret = reader.readKey(key, length);
+                    if (ret != PARSE_OK) break;
+                    auto iter = index_.find(std::string_view(key, length));
+
+                    // 冒号
+                    reader.parseWhitespace();
+                    if (reader.peek() != ':') {
+                        ret = PARSE_MISS_COLON;
+                        break;
+                    }
+                    // 与MyJSON::parse一致，空key在冒号之后才报错
+                    if (length == 0) {
+                        ret = PARSE_MISS_KEY;
+                        break;
+                    }
+                    reader.advance();
+                    reader.parseWhitespace();
+
+                    // 解析value，未声明或重复的key跳过
+                    if (iter == index_.end() || seen_[iter->second]) {
+                        ret = reader.skipValue();
+                    } else {
+                        seen_[iter->second] = true;
+                        ret = parseCell(reader, columns_[iter->second], rows_);
+                    }
+                    if (ret != PARSE_OK) break;
+                    reader.parseWhitespace();
+
+                    if (reader.peek() == ',') {
+                        reader.advance();
+                        reader.parseWhitespace();
+                    } else if (reader.peek() == '}') {
+                        reader.advance();
+                        break;
+                    } else {
+                        ret = PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                        break;
+                    }
+                }
+                if (ret != PARSE_OK) break;
+            }
+            endRow();
+            reader.parseWhitespace();
+            if (reader.peek() == ',') {
+                reader.advance();
+                reader.parseWhitespace();
+            } else if (reader.peek() == ']') {
+                reader.advance();
+                break;
+            } else {
+                ret = PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                break;
+            }
+        }
+    }
+    if (ret == PARSE_OK) {
+        reader.parseWhitespace();
+        if (reader.peek() != '\0') ret = PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (ret != PARSE_OK) {
+        seen_.assign(columns_.size(), false);
+        clear();
+    }
+    return ret;
+}
+
+const JSONColumn &JSONColumns::operator[](const std::string &name) const {
+    auto iter = index_.find(name);
+    if (iter == index_.end()) throw std::out_of_range("json don't has that column");
+    return columns_[iter->second];
+}
+
+JSONParseResult JSONColumns::extract(MyJSON &json) {
+    clear();
+    if (json.type_ != JSON_ARRAY) return PARSE_TYPE_MISMATCH;
+    for (auto &element: json.value_.arrVal) {
+        if (element.type_ != JSON_OBJECT) {
+            clear();
+            return PARSE_TYPE_MISMATCH;
+        }
+        for (auto &column: columns_) {
+            auto iter = element.value_.jVal.find(column.name);
+            if (iter == element.value_.jVal.end() || iter->second.type_ == JSON_NULL) {
+                column.appendNull(rows_);
+                continue;
+            }
+            MyJSON &value = iter->second;
+            bool match = true;
+            bool tooBig = false;
+            switch (column.type) {
+                case COLUMN_DOUBLE:
+                    match = value.type_ == JSON_NUMBER;
+                    if (match) column.doubles.push_back(value.getNumber());
+                    break;
+                case COLUMN_INT64: {
+                    // 与直接解析一致：小数和指数形式的数字不能放进整数列，超出int64时为PARSE_NUMBER_TOO_BIG
+                    match = value.type_ == JSON_NUMBER;
+                    if (!match) break;
+                    const std::string &raw = value.value_.sVal;
+                    int64_t n;
+                    if (raw.empty()) {
+                        double d = value.getNumber();
+                        match = std::floor(d) == d;
+                        tooBig = !(d >= -9223372036854775808.0 && d < 9223372036854775808.0);
+                        n = match && !tooBig ? (int64_t) d : 0;
+                    } else {
+                        match = raw.find_first_of(".eE") == std::string::npos;
+                        errno = 0;
+                        n = match ? strtoll(raw.c_str(), nullptr, 10) : 0;
+                        tooBig = errno == ERANGE;
+                    }
+                    if (match && !tooBig) column.ints.push_back(n);
+                    break;
+                }
+                case COLUMN_STRING:
+                    match = value.type_ == JSON_STRING;
+                    if (match) {
+                        column.chars += value.value_.sVal;
+                        column.offsets.push_back(column.chars.size());
+                    }
+                    break;
+            }
+            if (!match || tooBig) {
+                clear();
+                return match ? PARSE_NUMBER_TOO_BIG : PARSE_TYPE_MISMATCH;
+            }
+            if (rows_ % 8 == 0) column.validity.push_back(0);
+            column.setValid(rows_);
+        }
+        rows_++;
+    }
+    return PARSE_OK;
+}
@@ -0,0 +1,80 @@
+//
+// 把同构对象数组转换成按列存储
+//
+//     JSONColumns columns;
+//     columns.addColumn("ts", COLUMN_DOUBLE);
+//     columns.addColumn("host", COLUMN_STRING);
+//     columns.parse("[{\"ts\":1,\"host\":\"a\"},{\"ts\":2}]");
+//     columns["ts"].doubles    -> {1, 2}
+//     columns["host"].isNull(1) -> true
+//
+// 缺失的key和null都记为空值；未声明的key被跳过；重复的key以第一次出现为准。
+//
+
+#ifndef MY_JSON_MY_JSON_COLUMNS_H
+#define MY_JSON_MY_JSON_COLUMNS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "my_json.h"
+
+enum JSONColumnType {
+    COLUMN_DOUBLE, COLUMN_INT64, COLUMN_STRING
+};
+
+struct JSONColumn {
+    std::string name;
+    JSONColumnType type;
+    std::vector<double> doubles;        // COLUMN_DOUBLE，空值处为0
+    std::vector<int64_t> ints;          // COLUMN_INT64，空值处为0
+    std::string chars;                  // COLUMN_STRING，所有字符串首尾相接
+    std::vector<size_t> offsets;        // COLUMN_STRING，第i行为chars[offsets[i], offsets[i + 1])
+    std::vector<uint8_t> validity;      // 第i行非空时第i位为1，低位在前
+
+    JSONColumn(std::string name, JSONColumnType type) : name(std::move(name)), type(type), offsets(1, 0) {}
+
+    bool isNull(size_t row) const { return !((validity[row / 8] >> (row % 8)) & 1); }
+
+    std::string_view getString(size_t row) const {
+        return std::string_view(chars).substr(offsets[row], offsets[row + 1] - offsets[row]);
+    }
+
+    void clear();
+
+    void appendNull(size_t row);
+
+    void setValid(size_t row);
+};
+
+class JSONColumns {
+public:
+    void addColumn(const std::string &name, JSONColumnType type);
+
+    // 直接解析顶层为对象数组的JSON文本，不构建MyJSON树
+    JSONParseResult parse(const char *json);
+
+    // 从已解析的树中提取
+    JSONParseResult extract(MyJSON &json);
+
+    size_t rows() const { return rows_; }
+
+    // 未声明的列抛出std::out_of_range
+    const JSONColumn &operator[](const std::string &name) const;
+
+    const std::vector<JSONColumn> &columns() const { return columns_; }
+
+private:
+    std::vector<JSONColumn> columns_;
+    std::map<std::string, size_t, std::less<>> index_;
+    std::vector<bool> seen_;
+    size_t rows_ = 0;
+
+    void clear();
+
+    void endRow();
+};
+
+#endif //MY_JSON_MY_JSON_COLUMNS_H
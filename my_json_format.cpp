@@ -0,0 +1,236 @@
+//
+// 字节流上的压缩/缩进。字符串内部和空白用SSE2每次扫描16字节，其余字节原样成段复制。
+//
+#include <cstring>
+#include "my_json_format.h"
+#include "my_json_internal.h"
+
+static inline bool isWhitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+// 字符串内第一个'"'或'\\'
+static const char *findStringSpecial(const char *p, const char *end) {
+#ifdef MY_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) p);
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                        _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask) return p + jsonFirstBit(mask);
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\') p++;
+    return p;
+}
+
+#ifdef MY_JSON_SSE2
+
+static inline __m128i whitespaceMask(__m128i chunk) {
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+    ws = _mm_or_si128(ws, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+    return _mm_or_si128(ws, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+}
+
+#endif
+
+// 第一个非空白字符
+static const char *skipWhitespace(const char *p, const char *end) {
+#ifdef MY_JSON_SSE2
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) p);
+        unsigned mask = ~_mm_movemask_epi8(whitespaceMask(chunk)) & 0xffff;
+        if (mask) return p + jsonFirstBit(mask);
+    }
+#endif
+    while (p < end && isWhitespace(*p)) p++;
+    return p;
+}
+
+// 数字和true/false/null的结尾
+static const char *findScalarEnd(const char *p, const char *end) {
+    while (p < end) {
+        switch (*p) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+            case ',':
+            case ':':
+            case '[':
+            case ']':
+            case '{':
+            case '}':
+            case '"':
+                return p;
+            default:
+                p++;
+        }
+    }
+    return p;
+}
+
+void JSONFormatter::feed(const char *json, size_t length) {
+    if (indent_) feedPretty(json, json + length);
+    else feedMinify(json, json + length);
+}
+
+void JSONFormatter::minify(const char *json, size_t length, std::string &out) {
+    out.reserve(out.size() + length);
+    JSONFormatter(out).feed(json, length);
+}
+
+void JSONFormatter::prettify(const char *json, size_t length, std::string &out, unsigned indent) {
+    out.reserve(out.size() + length + length / 2);
+    JSONFormatter(out, indent ? indent : 1).feed(json, length);
+}
+
+const char *JSONFormatter::copyString(const char *p, const char *end) {
+    if (escape_) {
+        // 上一段以'\\'结尾，转义字符原样复制；\uXXXX后面的十六进制数字按普通字符处理
+        out_ += *p++;
+        escape_ = false;
+    }
+    while (p < end) {
+        const char *run = findStringSpecial(p, end);
+        out_.append(p, run - p);
+        p = run;
+        if (p == end) break;
+        out_ += *p;
+        if (*p++ == '"') {
+            inString_ = false;
+            return p;
+        }
+        if (p == end) {
+            escape_ = true;
+            return p;
+        }
+        out_ += *p++;
+    }
+    return p;
+}
+
+void JSONFormatter::newline() {
+    out_ += '\n';
+    out_.append(depth_ * indent_, ' ');
+}
+
+void JSONFormatter::feedMinify(const char *p, const char *end) {
+    // 压缩后不会变长，直接写入预留好的缓冲区
+    size_t size = out_.size();
+    out_.resize(size + (end - p));
+    char *dst = &out_[size];
+    while (p < end) {
+        if (inString_) {
+            if (escape_) {
+                *dst++ = *p++;
+                escape_ = false;
+                continue;
+            }
+            const char *run = findStringSpecial(p, end);
+            memcpy(dst, p, run - p);
+            dst += run - p;
+            p = run;
+            if (p == end) break;
+            char ch = *dst++ = *p++;
+            if (ch == '"') inString_ = false;
+            else escape_ = true;
+            continue;
+        }
+#ifdef MY_JSON_SSE2
+        if (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *) p);
+            unsigned quote = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+            unsigned ws = _mm_movemask_epi8(whitespaceMask(chunk));
+            int n = quote ? jsonFirstBit(quote) : 16;
+            if (ws == 0) {
+                memcpy(dst, p, n);
+                dst += n;
+            } else if (ws != 0xffff) {
+                // 逐段复制空白之间的内容。输出不比输入长，p + start之后还有16字节时dst之后也有，
+                // 可以整块写入，多写的部分会被后面的内容覆盖
+                unsigned keep = ~ws & ((1u << n) - 1);
+                while (keep) {
+                    int start = jsonFirstBit(keep);
+                    int length = jsonFirstBit(~(keep >> start));
+                    if (end - p >= start + 16)
+                        _mm_storeu_si128((__m128i *) dst, _mm_loadu_si128((const __m128i *) (p + start)));
+                    else
+                        memcpy(dst, p + start, length);
+                    dst += length;
+                    keep &= ~0u << (start + length);
+                }
+            }
+            p += n;
+            if (quote) {
+                *dst++ = *p++;
+                inString_ = true;
+            }
+            continue;
+        }
+#endif
+        char ch = *p++;
+        if (ch == '"') inString_ = true;
+        *dst = ch;
+        dst += !isWhitespace(ch);
+    }
+    out_.resize(dst - out_.data());
+}
+
+void JSONFormatter::feedPretty(const char *p, const char *end) {
+    while (p < end) {
+        if (inString_) {
+            p = copyString(p, end);
+            continue;
+        }
+        char ch = *p;
+        if (isWhitespace(ch)) {
+            p = skipWhitespace(p, end);
+            continue;
+        }
+        if (pendingOpen_) {
+            pendingOpen_ = false;
+            if (ch == '}' || ch == ']') {
+                // 空容器保持在同一行
+                out_ += ch;
+                p++;
+                continue;
+            }
+            depth_++;
+            newline();
+        }
+        switch (ch) {
+            case '{':
+            case '[':
+                out_ += ch;
+                pendingOpen_ = true;
+                break;
+            case '}':
+            case ']':
+                // 输入不合法时多出的闭括号不再减少缩进
+                if (depth_) depth_--;
+                newline();
+                out_ += ch;
+                break;
+            case ',':
+                out_ += ',';
+                newline();
+                break;
+            case ':':
+                out_ += ": ";
+                break;
+            case '"':
+                out_ += '"';
+                inString_ = true;
+                break;
+            default: {
+                const char *run = findScalarEnd(p, end);
+                out_.append(p, run - p);
+                p = run;
+                continue;
+            }
+        }
+        p++;
+    }
+}
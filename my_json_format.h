@@ -0,0 +1,42 @@
+//
+// 不解析成树，直接在字节流上压缩或重新缩进JSON
+//
+// 输入须是合法的JSON（可先用MyJSON::validate检查），数字和字符串按原样输出。
+// 可以分多次feed，字符串和转义可以跨越两次feed的边界。
+//
+
+#ifndef MY_JSON_MY_JSON_FORMAT_H
+#define MY_JSON_MY_JSON_FORMAT_H
+
+#include <string>
+
+class JSONFormatter {
+public:
+    // indent为0时压缩，否则每层缩进indent个空格
+    explicit JSONFormatter(std::string &out, unsigned indent = 0) : out_(out), indent_(indent) {}
+
+    void feed(const char *json, size_t length);
+
+    static void minify(const char *json, size_t length, std::string &out);
+
+    static void prettify(const char *json, size_t length, std::string &out, unsigned indent = 4);
+
+private:
+    std::string &out_;
+    unsigned indent_;
+    size_t depth_ = 0;
+    bool inString_ = false;
+    bool escape_ = false;
+    // 刚输出'{'或'['，要看到下一个字符才知道是否为空容器
+    bool pendingOpen_ = false;
+
+    void feedMinify(const char *p, const char *end);
+
+    void feedPretty(const char *p, const char *end);
+
+    const char *copyString(const char *p, const char *end);
+
+    void newline();
+};
+
+#endif //MY_JSON_MY_JSON_FORMAT_H
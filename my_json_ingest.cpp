@@ -0,0 +1,385 @@
+//
+// 大文件流水线解析
+//
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "my_json_ingest.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MY_JSON_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 按页对齐；末尾留出写'\0'和SSE2按16字节对齐读取的余量
+constexpr size_t BLOCK_ALIGN = 4096;
+constexpr size_t BLOCK_PADDING = 64;
+
+struct Block {
+    char *data;
+    size_t capacity;
+    size_t size = 0;
+    size_t firstRecord = 0;
+    std::vector<std::pair<size_t, size_t>> records;     // [begin, end)，end处是分隔符或数据末尾
+
+    explicit Block(size_t capacity) : data(allocate(capacity)), capacity(capacity) {}
+
+    Block(const Block &) = delete;
+
+    Block &operator=(const Block &) = delete;
+
+    ~Block() { ::operator delete(data, std::align_val_t(BLOCK_ALIGN)); }
+
+    // 保留已有数据
+    void grow(size_t newCapacity) {
+        char *newData = allocate(newCapacity);
+        memcpy(newData, data, size);
+        ::operator delete(data, std::align_val_t(BLOCK_ALIGN));
+        data = newData;
+        capacity = newCapacity;
+    }
+
+    static char *allocate(size_t capacity) {
+        return (char *) ::operator new(capacity + BLOCK_PADDING, std::align_val_t(BLOCK_ALIGN));
+    }
+};
+
+class BlockQueue {
+public:
+    void push(Block *block) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocks_.push_back(block);
+        }
+        ready_.notify_one();
+    }
+
+    // 队列关闭且为空时返回nullptr；waited表示是否等待过
+    Block *pop(bool &waited) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waited = blocks_.empty() && !closed_;
+        ready_.wait(lock, [this] { return !blocks_.empty() || closed_; });
+        if (blocks_.empty()) return nullptr;
+        Block *block = blocks_.front();
+        blocks_.pop_front();
+        return block;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Block *> blocks_;
+    bool closed_ = false;
+};
+
+// 顺序读文件；POSIX下直接read并提示内核顺序预读，其他平台用stdio
+class FileSource {
+public:
+    explicit FileSource(const char *path) {
+#ifdef MY_JSON_POSIX_IO
+        fd_ = open(path, O_RDONLY);
+#if defined(__linux__)
+        if (fd_ >= 0) posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+        file_ = fopen(path, "rb");
+#endif
+    }
+
+    FileSource(const FileSource &) = delete;
+
+    FileSource &operator=(const FileSource &) = delete;
+
+    ~FileSource() {
+#ifdef MY_JSON_POSIX_IO
+        if (fd_ >= 0) close(fd_);
+#else
+        if (file_) fclose(file_);
+#endif
+    }
+
+    bool isOpen() const {
+#ifdef MY_JSON_POSIX_IO
+        return fd_ >= 0;
+#else
+        return file_ != nullptr;
+#endif
+    }
+
+    // 返回读到的字节数，0为文件结束，-1为出错
+    long long read(char *p, size_t size) {
+        size = std::min(size, (size_t) 1 << 30);
+#ifdef MY_JSON_POSIX_IO
+        while (true) {
+            ssize_t n = ::read(fd_, p, size);
+            if (n >= 0) return n;
+            if (errno != EINTR) return -1;
+        }
+#else
+        size_t n = fread(p, 1, size, file_);
+        if (n == 0 && ferror(file_)) return -1;
+        return (long long) n;
+#endif
+    }
+
+private:
+#ifdef MY_JSON_POSIX_IO
+    int fd_ = -1;
+#else
+    FILE *file_ = nullptr;
+#endif
+};
+
+// 在读取线程中找记录边界，只做引号和括号配对，记录本身的语法留给解析线程检查
+class RecordSplitter {
+public:
+    explicit RecordSplitter(JSONIngestFormat format) : format_(format) {}
+
+    // 把block中完整的记录追加到block.records，boundary为剩余不完整部分的开始位置。
+    // eof为true时数据已读完
+    JSONParseResult split(Block &block, bool eof, size_t &boundary) {
+        return format_ == INGEST_JSON_LINES ? splitLines(block, eof, boundary) : splitArray(block, eof, boundary);
+    }
+
+private:
+    JSONIngestFormat format_;
+    bool opened_ = false;   // 已看到顶层数组的'['
+    bool closed_ = false;   // 已看到顶层数组的']'
+    bool emitted_ = false;  // 已有过元素
+
+    static bool isWhitespace(char ch) { return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'; }
+
+    static JSONParseResult splitLines(Block &block, bool eof, size_t &boundary) {
+        const char *data = block.data;
+        size_t start = 0;
+        while (const char *newline = (const char *) memchr(data + start, '\n', block.size - start)) {
+            block.records.emplace_back(start, newline - data);
+            start = newline - data + 1;
+        }
+        if (eof && start < block.size) {
+            block.records.emplace_back(start, block.size);
+            start = block.size;
+        }
+        boundary = start;
+        return PARSE_OK;
+    }
+
+    JSONParseResult splitArray(Block &block, bool eof, size_t &boundary) {
+        const char *data = block.data;
+        size_t size = block.size;
+        size_t i = 0;
+        boundary = size;
+        if (closed_) return trailing(data, 0, size);
+        if (!opened_) {
+            while (i < size && isWhitespace(data[i])) i++;
+            if (i == size) return eof ? PARSE_EXPECT_VALUE : PARSE_OK;
+            if (data[i] != '[') return PARSE_INVALID_VALUE;
+            opened_ = true;
+            i++;
+        }
+        size_t start = i;
+        size_t depth = 0;
+        bool inString = false;
+        bool escape = false;
+        for (; i < size; i++) {
+            char ch = data[i];
+            if (inString) {
+                if (escape) escape = false;
+                else if (ch == '\\') escape = true;
+                else if (ch == '"') inString = false;
+                continue;
+            }
+            switch (ch) {
+                case '"':
+                    inString = true;
+                    break;
+                case '[':
+                case '{':
+                    depth++;
+                    break;
+                case ']':
+                case '}':
+                    if (depth) {
+                        depth--;
+                    } else if (ch == ']') {
+                        // 空数组没有元素，"[1,]"则留下一个空元素交给解析报错
+                        if (emitted_ || !blank(data, start, i)) block.records.emplace_back(start, i);
+                        closed_ = true;
+                        return trailing(data, i + 1, size);
+                    }
+                    break;
+                case ',':
+                    if (depth == 0) {
+                        block.records.emplace_back(start, i);
+                        emitted_ = true;
+                        start = i + 1;
+                    }
+                    break;
+            }
+        }
+        boundary = start;
+        return eof ? PARSE_MISS_COMMA_OR_SQUARE_BRACKET : PARSE_OK;
+    }
+
+    static bool blank(const char *data, size_t begin, size_t end) {
+        while (begin < end && isWhitespace(data[begin])) begin++;
+        return begin == end;
+    }
+
+    static JSONParseResult trailing(const char *data, size_t begin, size_t end) {
+        return blank(data, begin, end) ? PARSE_OK : PARSE_ROOT_NOT_SINGULAR;
+    }
+};
+
+}
+
+JSONParseResult JSONIngest::run(const char *path, const Callback &callback, size_t *errorRecord) {
+    stats_ = JSONIngestStats();
+    FileSource source(path);
+    if (!source.isOpen()) return PARSE_IO_ERROR;
+
+    size_t bufferSize = std::max(options_.bufferSize, (size_t) 16);
+    size_t count = std::max(options_.buffers, (size_t) 2);
+    unsigned workers = options_.workers ? options_.workers : std::max(std::thread::hardware_concurrency(), 1u);
+    // 所有解析线程共用options_.parse.keys，不是线程安全的表时只能有一个解析线程
+    if (options_.parse.keys && !options_.parse.keys->threadSafe()) workers = 1;
+    std::vector<std::unique_ptr<Block>> blocks;
+    BlockQueue freeBlocks, fullBlocks;
+    for (size_t i = 0; i < count; i++) {
+        blocks.push_back(std::make_unique<Block>(bufferSize));
+        freeBlocks.push(blocks.back().get());
+    }
+
+    // 报告文件中的第一个错误：出错后序号更小的记录仍继续解析
+    std::atomic<bool> failed{false};
+    std::atomic<size_t> errorAt{(size_t) -1};
+    std::mutex errorMutex;
+    JSONParseResult result = PARSE_OK;
+    auto fail = [&](JSONParseResult ret, size_t record) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (record < errorAt) {
+            errorAt = record;
+            result = ret;
+        }
+        failed = true;
+    };
+
+    std::atomic<size_t> records{0};
+    std::atomic<size_t> workerWaits{0};
+    bool lines = options_.format == INGEST_JSON_LINES;
+    std::vector<std::thread> threads;
+    for (unsigned worker = 0; worker < workers; worker++) {
+        threads.emplace_back([&, worker] {
+            JSONParser parser(options_.parse);
+            bool waited;
+            while (Block *block = fullBlocks.pop(waited)) {
+                if (waited) workerWaits++;
+                size_t record = block->firstRecord;
+                size_t parsed = 0;
+                for (auto [begin, end]: block->records) {
+                    if (record >= errorAt) break;
+                    char *p = block->data + begin;
+                    block->data[end] = '\0';
+                    if (lines) {
+                        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+                        if (*p == '\0') {
+                            record++;
+                            continue;
+                        }
+                    }
+                    JSONParseResult ret = parser.parse(p);
+                    if (ret != PARSE_OK) {
+                        fail(ret, record);
+                        break;
+                    }
+                    callback(record++, parser.document(), worker);
+                    parsed++;
+                }
+                records += parsed;
+                freeBlocks.push(block);
+            }
+        });
+    }
+
+    // 读取线程即当前线程
+    RecordSplitter splitter(options_.format);
+    size_t nextRecord = 0;
+    bool waited;
+    Block *block = freeBlocks.pop(waited);
+    block->size = 0;
+    while (block && !failed) {
+        long long n = source.read(block->data + block->size, block->capacity - block->size);
+        if (n < 0) {
+            fail(PARSE_IO_ERROR, nextRecord);
+            break;
+        }
+        stats_.bytes += n;
+        block->size += n;
+        bool eof = n == 0;
+        // 读满一块再切分
+        if (!eof && block->size < block->capacity) continue;
+
+        block->records.clear();
+        block->firstRecord = nextRecord;
+        size_t boundary;
+        JSONParseResult ret = splitter.split(*block, eof, boundary);
+        nextRecord += block->records.size();
+        if (ret != PARSE_OK) {
+            // 出错位置之前已切出的记录照常解析，其中更早的错误优先报告
+            if (block->records.empty()) freeBlocks.push(block);
+            else fullBlocks.push(block);
+            fail(ret, nextRecord);
+            break;
+        }
+        if (!eof && boundary == 0) {
+            // 一条记录比整块还大
+            block->grow(block->capacity * 2);
+            continue;
+        }
+
+        // 先把不完整的尾部复制到下一块，解析线程会在记录末尾写'\0'
+        Block *next = nullptr;
+        if (!eof) {
+            next = freeBlocks.pop(waited);
+            if (waited) stats_.readerWaits++;
+            size_t tail = block->size - boundary;
+            if (tail * 2 > next->capacity) {
+                next->size = 0;
+                next->grow(tail * 2);
+            }
+            memcpy(next->data, block->data + boundary, tail);
+            next->size = tail;
+        }
+        if (block->records.empty()) freeBlocks.push(block);
+        else fullBlocks.push(block);
+        block = next;
+    }
+    fullBlocks.close();
+    for (auto &thread: threads) thread.join();
+
+    stats_.records = records;
+    stats_.workerWaits = workerWaits;
+    if (result != PARSE_OK && errorRecord) *errorRecord = errorAt;
+    return result;
+}
@@ -0,0 +1,58 @@
+//
+// 大文件流水线解析：读取线程和解析线程同时工作
+//
+//     JSONIngest ingest;
+//     ingest.run("logs.jsonl", [](size_t record, MyJSON &value, unsigned worker) { ... });
+//
+// 读取线程按固定大小的块读文件，在记录边界处切开（不完整的尾部复制到下一块开头），
+// 通过有界队列交给解析线程；解析完的块回到空闲池中复用。空闲块用完时读取线程等待，
+// 因此内存占用固定，吞吐接近磁盘和CPU中较慢的一方。
+//
+
+#ifndef MY_JSON_MY_JSON_INGEST_H
+#define MY_JSON_MY_JSON_INGEST_H
+
+#include <cstddef>
+#include <functional>
+#include "my_json.h"
+
+enum JSONIngestFormat {
+    INGEST_JSON_LINES,  // 每行一个JSON值，空行被跳过
+    INGEST_JSON_ARRAY   // 顶层数组，每个元素为一条记录
+};
+
+struct JSONIngestOptions {
+    JSONIngestFormat format = INGEST_JSON_LINES;
+    size_t bufferSize = 4 << 20;    // 单条记录超过块大小时该块自动扩大
+    size_t buffers = 8;             // 块的总数，即在途数据的上限
+    unsigned workers = 0;           // 解析线程数，0为硬件线程数
+    // 所有解析线程共用其中的projection和keys；keys不是JSONKeyTable(true)时只用一个解析线程
+    JSONParseOptions parse;
+};
+
+struct JSONIngestStats {
+    size_t bytes = 0;
+    size_t records = 0;         // 交给回调的记录数
+    size_t readerWaits = 0;     // 读取线程等待空闲块的次数，多说明CPU是瓶颈
+    size_t workerWaits = 0;     // 解析线程等待数据的次数，多说明磁盘是瓶颈
+};
+
+class JSONIngest {
+public:
+    // record为记录序号：JSON Lines中为行号，数组中为元素下标，都从0开始。
+    // 回调在解析线程中并发调用，顺序不确定；value只在回调期间有效
+    using Callback = std::function<void(size_t record, MyJSON &value, unsigned worker)>;
+
+    explicit JSONIngest(const JSONIngestOptions &options = JSONIngestOptions()) : options_(options) {}
+
+    // 遇到第一个错误后停止，errorRecord为出错的记录序号；打不开或读文件失败时返回PARSE_IO_ERROR
+    JSONParseResult run(const char *path, const Callback &callback, size_t *errorRecord = nullptr);
+
+    const JSONIngestStats &stats() const { return stats_; }
+
+private:
+    JSONIngestOptions options_;
+    JSONIngestStats stats_;
+};
+
+#endif //MY_JSON_MY_JSON_INGEST_H
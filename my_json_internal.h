@@ -0,0 +1,398 @@
+//
+// 解析器、绑定和格式化共用的底层工具：SSE2检测、数字语法、\u解码、UTF-8编码与校验、字符串解码。
+// 不属于公开接口，只供本库的头文件和源文件包含
+//
+
+// my_json.h在末尾包含my_json.inl，后者又包含本文件，所以先于include guard包含my_json.h，
+// 保证无论先包含哪个头文件，这里的内容都出现在my_json.inl之前
+#include "my_json.h"
+
+#ifndef MY_JSON_MY_JSON_INTERNAL_H
+#define MY_JSON_MY_JSON_INTERNAL_H
+
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define MY_JSON_SSE2
+
+// mask中最低的置位，mask不能为0
+inline int jsonFirstBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int) index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#endif
+
+#ifdef MY_JSON_STATS
+
+#include <chrono>
+
+// 统计的采样和计时，实现在my_json.cpp中
+bool jsonStatsSampled();
+
+std::chrono::steady_clock::time_point jsonStatsBegin(JSONStats &stats, JSONStatsOp op);
+
+double jsonStatsSince(std::chrono::steady_clock::time_point start);
+
+// 调用前已累加好PHASE_STRING和PHASE_NUMBER，其余时间都记为PHASE_STRUCTURE；采样到的结果交给report
+void jsonStatsEnd(JSONStats &stats, std::chrono::steady_clock::time_point start);
+
+// 把所在作用域的耗时累加到stats的一个阶段；stats为空（未采样）时不读时钟
+class JSONStatsTimer {
+public:
+    JSONStatsTimer(JSONStats *stats, JSONStatsPhase phase) : stats_(stats), phase_(phase) {
+        if (stats_) start_ = std::chrono::steady_clock::now();
+    }
+
+    ~JSONStatsTimer() {
+        if (stats_) stats_->phaseSeconds[phase_] += jsonStatsSince(start_);
+    }
+
+    JSONStatsTimer(const JSONStatsTimer &) = delete;
+
+    JSONStatsTimer &operator=(const JSONStatsTimer &) = delete;
+
+private:
+    JSONStats *stats_;
+    JSONStatsPhase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif
+
+// 有意越过字符串结尾读取的函数不做AddressSanitizer检查
+#if defined(_MSC_VER)
+#define MY_JSON_NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#elif defined(__GNUC__) || defined(__clang__)
+#define MY_JSON_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define MY_JSON_NO_SANITIZE_ADDRESS
+#endif
+
+inline bool jsonIsDigit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+// 按JSON语法扫描数字，返回数字结尾，语法错误时返回nullptr；end为nullptr时以'\0'结尾。
+// tooBig表示超出double范围，与strtod的判断一致，但只有最高位在10^308附近时才真正转换
+inline const char *jsonScanNumber(const char *p, const char *end, bool &tooBig) {
+    auto peek = [&p, end]() { return end && p >= end ? '\0' : *p; };
+    const char *start = p;
+    // magnitude: 最高有效位的十进制位置，值在[10^(magnitude-1), 10^magnitude)之间
+    long magnitude = 0;
+    bool zero = true;
+    if (peek() == '-') p++;
+    if (peek() == '0') p++;
+    else {
+        if (peek() < '1' || peek() > '9') return nullptr;
+        const char *digits = p;
+        do { p++; } while (jsonIsDigit(peek()));
+        magnitude = p - digits;
+        zero = false;
+    }
+    if (peek() == '.') {
+        p++;
+        if (!jsonIsDigit(peek())) return nullptr;
+        const char *digits = p;
+        do { p++; } while (jsonIsDigit(peek()));
+        if (zero) {
+            const char *q = digits;
+            while (q < p && *q == '0') q++;
+            magnitude = digits - q;
+            zero = q == p;
+        }
+    }
+    if (peek() == 'e' || peek() == 'E') {
+        p++;
+        bool negative = peek() == '-';
+        if (peek() == '+' || peek() == '-') p++;
+        if (!jsonIsDigit(peek())) return nullptr;
+        long exponent = 0;
+        do {
+            if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
+            p++;
+        } while (jsonIsDigit(peek()));
+        magnitude += negative ? -exponent : exponent;
+    }
+    tooBig = false;
+    if (zero || magnitude <= 308) return p;
+    if (magnitude == 309) {
+        // strtod需要以'\0'结尾的副本；一般放在栈上，特别长的数字才复制到堆上
+        char buffer[1024];
+        std::string heap;
+        const char *text = buffer;
+        size_t size = p - start;
+        if (size < sizeof(buffer)) {
+            memcpy(buffer, start, size);
+            buffer[size] = '\0';
+        } else {
+            heap.assign(start, size);
+            text = heap.c_str();
+        }
+        errno = 0;
+        double d = strtod(text, nullptr);
+        if (!(errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL))) return p;
+    }
+    tooBig = true;
+    return p;
+}
+
+// 跳过p处的"//"或"/*"注释；块注释未闭合时返回nullptr
+inline const char *jsonSkipComment(const char *p) {
+    if (p[1] == '/') {
+        p += 2;
+        while (*p != '\n' && *p != '\0') p++;
+        return p;
+    }
+    const char *end = strstr(p + 2, "*/");
+    return end ? end + 2 : nullptr;
+}
+
+inline bool jsonIsComment(const char *p) {
+    return p[0] == '/' && (p[1] == '/' || p[1] == '*');
+}
+
+// 第一个'"'、'\\'或'\0'。
+// 按16字节对齐读取：对齐的16字节不会跨页，只要其中有一个字节属于字符串（包括结尾的'\0'），
+// 整块都在已映射的页内，所以读到'\0'之后的字节不会出错。这些字节不属于任何对象，
+// AddressSanitizer会报越界，因此对这个函数关闭检查
+MY_JSON_NO_SANITIZE_ADDRESS
+inline const char *jsonFindStringSpecial(const char *p) {
+#ifdef MY_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+    const char *aligned = (const char *) ((uintptr_t) p & ~(uintptr_t) 15);
+    unsigned offset = (unsigned) (p - aligned);
+    while (true) {
+        __m128i chunk = _mm_load_si128((const __m128i *) aligned);
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                     _mm_cmpeq_epi8(chunk, zero));
+        unsigned mask = ((unsigned) _mm_movemask_epi8(match) >> offset) << offset;
+        if (mask) return aligned + jsonFirstBit(mask);
+        aligned += 16;
+        offset = 0;
+    }
+#else
+    while (*p != '"' && *p != '\\' && *p != '\0') p++;
+    return p;
+#endif
+}
+
+// 跳过字符串，返回结束引号之后的位置；未闭合时返回nullptr
+inline const char *jsonSkipString(const char *p) {
+    p++;
+    while (true) {
+        p = jsonFindStringSpecial(p);
+        if (*p == '"') return p + 1;
+        if (*p == '\0' || p[1] == '\0') return nullptr;
+        p += 2;
+    }
+}
+
+// 只接受int64范围内的整数，返回数字之后的位置，不合法时返回nullptr
+inline const char *jsonScanInt64(const char *p, bool &tooBig) {
+    tooBig = false;
+    bool negative = *p == '-';
+    if (negative) p++;
+    const char *digits = p;
+    if (*p == '0') {
+        p++;
+    } else if (*p >= '1' && *p <= '9') {
+        while (*p >= '0' && *p <= '9') p++;
+    } else {
+        return nullptr;
+    }
+    if (*p == '.' || *p == 'e' || *p == 'E') return nullptr;
+    size_t size = p - digits;
+    if (size > 19) tooBig = true;
+    else if (size == 19) tooBig = memcmp(digits, negative ? "9223372036854775808" : "9223372036854775807", 19) > 0;
+    return p;
+}
+
+// 十六进制字符到数值，非十六进制字符为-1
+struct JSONHexTable {
+    signed char value[256];
+
+    constexpr JSONHexTable() : value() {
+        for (int i = 0; i < 256; i++) value[i] = -1;
+        for (int i = 0; i < 10; i++) value['0' + i] = (signed char) i;
+        for (int i = 0; i < 6; i++) value['a' + i] = value['A' + i] = (signed char) (10 + i);
+    }
+};
+
+inline constexpr JSONHexTable jsonHexTable;
+
+// 恰好读取4个十六进制字符；遇到非法字符（包括'\0'）立即停止，不会越过字符串结尾
+inline bool jsonParseHex4(const char *&p, unsigned &u) {
+    u = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = jsonHexTable.value[(unsigned char) p[i]];
+        if (digit < 0) return false;
+        u = (u << 4) | digit;
+    }
+    p += 4;
+    return true;
+}
+
+// p处UTF-8序列的字节数，非法时返回0。
+// 拒绝过长编码、代理区(U+D800~U+DFFF)和大于U+10FFFF的码点
+inline int jsonUTF8SequenceLength(const char *p, const char *end) {
+    unsigned char ch = *p;
+    if (ch < 0x80) return 1;
+    int size;
+    unsigned u, min;
+    if ((ch & 0xe0) == 0xc0) {
+        size = 2;
+        u = ch & 0x1f;
+        min = 0x80;
+    } else if ((ch & 0xf0) == 0xe0) {
+        size = 3;
+        u = ch & 0x0f;
+        min = 0x800;
+    } else if ((ch & 0xf8) == 0xf0) {
+        size = 4;
+        u = ch & 0x07;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
+    if (end - p < size) return 0;
+    for (int i = 1; i < size; i++) {
+        unsigned char next = p[i];
+        if ((next & 0xc0) != 0x80) return 0;
+        u = (u << 6) | (next & 0x3f);
+    }
+    if (u < min || u > 0x10ffff || (u >= 0xd800 && u <= 0xdfff)) return 0;
+    return size;
+}
+
+// 返回第一个非法UTF-8序列的位置，全部合法时返回end；ASCII部分每次用SSE2检查16字节
+inline const char *jsonFindInvalidUTF8(const char *p, const char *end) {
+    while (p < end) {
+#ifdef MY_JSON_SSE2
+        while (end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) p)) == 0) p += 16;
+        if (p == end) break;
+#endif
+        if ((unsigned char) *p < 0x80) {
+            p++;
+            continue;
+        }
+        int size = jsonUTF8SequenceLength(p, end);
+        if (size == 0) return p;
+        p += size;
+    }
+    return end;
+}
+
+inline void jsonEncodeUTF8(std::string &value, unsigned u) {
+    if (u <= 0x7f)
+        value.push_back(u & 0xff);
+    else if (u <= 0x7ff) {
+        value.push_back(0xc0 | ((u >> 6) & 0xff));
+        value.push_back(0x80 | (u & 0x3f));
+    } else if (u <= 0xffff) {
+        value.push_back(0xe0 | ((u >> 12) & 0xff));
+        value.push_back(0x80 | ((u >> 6) & 0x3f));
+        value.push_back(0x80 | (u & 0x3f));
+    } else {
+        assert(u <= 0x10ffff);
+        value.push_back(0xf0 | ((u >> 18) & 0xff));
+        value.push_back(0x80 | ((u >> 12) & 0x3f));
+        value.push_back(0x80 | ((u >> 6) & 0x3f));
+        value.push_back(0x80 | (u & 0x3f));
+    }
+}
+
+// 解码字符串并追加到value。p指向开头引号之后，成功时移到结尾引号之后。
+// escapes不为nullptr时累加转义序列的个数
+template<bool ValidateUTF8>
+JSONParseResult jsonDecodeString(const char *&p, std::string &value, size_t *escapes = nullptr) {
+    const char *start = p;
+    const char *q = p;
+    while (true) {
+        // 不需要处理的字符整段追加
+        const char *run = q;
+        while (*q != '"' && *q != '\\' && (unsigned char) *q >= 0x20) q++;
+        value.append(run, q - run);
+        char ch = *q++;
+        switch (ch) {
+            case '\"':
+                // 转义序列都是ASCII，直接检查原始字节即可
+                if (ValidateUTF8 && jsonFindInvalidUTF8(start, q - 1) != q - 1) return PARSE_INVALID_UTF8;
+                p = q;
+                return PARSE_OK;
+            case '\0':
+                return PARSE_MISS_QUOTATION_MARK;
+            case '\\': {
+                if (escapes) (*escapes)++;
+                switch (*q++) {
+                    case 'n':
+                        value.push_back('\n');
+                        break;
+                    case '\\':
+                        value.push_back('\\');
+                        break;
+                    case '\"':
+                        value.push_back('\"');
+                        break;
+                    case '/':
+                        value.push_back('/');
+                        break;
+                    case 'b':
+                        value.push_back('\b');
+                        break;
+                    case 'f':
+                        value.push_back('\f');
+                        break;
+                    case 'r':
+                        value.push_back('\r');
+                        break;
+                    case 't':
+                        value.push_back('\t');
+                        break;
+                    case 'u':
+                        unsigned u;
+                        if (!jsonParseHex4(q, u)) return PARSE_INVALID_UNICODE_HEX;
+                        if (u >= 0xd800 && u <= 0xdbff) {
+                            if (*q++ != '\\') return PARSE_INVALID_UNICODE_SURROGATE;
+                            if (*q++ != 'u') return PARSE_INVALID_UNICODE_SURROGATE;
+                            unsigned u2;
+                            if (!jsonParseHex4(q, u2)) return PARSE_INVALID_UNICODE_HEX;
+                            if (u2 < 0xdc00 || u2 > 0xdfff) return PARSE_INVALID_UNICODE_SURROGATE;
+                            u = (((u - 0xd800) << 10) | (u2 - 0xdc00)) + 0x10000;
+                        } else if (u >= 0xdc00 && u <= 0xdfff) {
+                            return PARSE_INVALID_UNICODE_SURROGATE;    // 单独的低代理项
+                        }
+                        jsonEncodeUTF8(value, u);
+                        break;
+                    default:
+                        return PARSE_INVALID_STRING_ESCAPE;
+                }
+                break;
+            }
+            default:
+                return PARSE_INVALID_STRING_CHAR;
+        }
+    }
+}
+
+#endif //MY_JSON_MY_JSON_INTERNAL_H
@@ -3,9 +3,37 @@
 //
 #include <cstdio>
 #include <cstdlib>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 #include <cstring>
 #include "my_json.h"
+#include "my_json_bind.h"
+#include "my_json_columns.h"
+#include "my_json_format.h"
+#include "my_json_ingest.h"
+
+/* 统计堆分配次数，用于检查JSONParser稳定后不再分配 */
+static std::atomic<size_t> alloc_count{0};
+
+void *operator new(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
 
 static int main_ret = 0;
 static int test_count = 0;
@@ -25,11 +53,18 @@ static int test_pass = 0;
 #define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%d")
 #define EXPECT_EQ_STRING(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%s")
 
+#if defined(_MSC_VER)
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%Iu")
+#else
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%zu")
+#endif
+
 #define TEST_ERROR(error, json)\
     do {\
         MyJSON myJson(JSON_NULL);\
         EXPECT_EQ_INT(error, myJson.parse(json));\
         EXPECT_EQ_INT(JSON_NULL, myJson.getType());\
+        EXPECT_EQ_INT(error, MyJSON::validate(json, strlen(json)));\
     } while(0)
 
 #define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%.17g")
@@ -40,6 +75,7 @@ static int test_pass = 0;
         EXPECT_EQ_INT(PARSE_OK, myJson.parse(json));\
         EXPECT_EQ_INT(JSON_NUMBER, myJson.getType());\
         EXPECT_EQ_DOUBLE(expect, myJson.getNumber());\
+        EXPECT_EQ_INT(PARSE_OK, MyJSON::validate(json, strlen(json)));\
     } while(0)
 
 
@@ -104,6 +140,8 @@ static void test_parse_miss_key() {
 static void test_parse_miss_colon() {
     TEST_ERROR(PARSE_MISS_COLON, "{\"a\"}");
     TEST_ERROR(PARSE_MISS_COLON, "{\"a\",\"b\"}");
+    TEST_ERROR(PARSE_MISS_COLON, "{\"\" 1}");
+    TEST_ERROR(PARSE_MISS_COLON, "{\"a\":1,\"\"}");
 }
 
 static void test_parse_miss_comma_or_curly_bracket() {
@@ -170,6 +208,14 @@ static void test_parse_number() {
 
     TEST_ERROR(PARSE_NUMBER_TOO_BIG, "1e309");
     TEST_ERROR(PARSE_NUMBER_TOO_BIG, "-1e309");
+
+    /* 最高位在10^308附近且超过1024字节的数字 */
+    std::string zeros(1000, '0');
+    std::string huge = "2" + std::string(308, '0') + "." + zeros;
+    TEST_ERROR(PARSE_NUMBER_TOO_BIG, huge.c_str());
+    TEST_ERROR(PARSE_NUMBER_TOO_BIG, ("-" + huge).c_str());
+    TEST_NUMBER(1e308, ("1" + std::string(308, '0') + "." + zeros).c_str());
+    TEST_NUMBER(1.7976931348623157e308, ("1.7976931348623157" + zeros + "e308").c_str());
 }
 
 #define TEST_STRING(expect, json)\
@@ -178,6 +224,7 @@ static void test_parse_number() {
         EXPECT_EQ_INT(PARSE_OK, myJson.parse(json));\
         EXPECT_EQ_INT(JSON_STRING, myJson.getType());\
         EXPECT_EQ_STRING(expect, myJson.getString());\
+        EXPECT_EQ_INT(PARSE_OK, MyJSON::validate(json, strlen(json)));\
     } while(0)
 
 
@@ -193,6 +240,60 @@ static void test_parse_invalid_string_char() {
     TEST_ERROR(PARSE_INVALID_STRING_CHAR, "\"\x1F\"");
 }
 
+static void test_parse_invalid_unicode_hex() {
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u0\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u01\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u012\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u/000\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\uG000\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u0G00\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u00G0\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u000G\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u 123\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u+123\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_HEX, "\"\\u-123\"");
+}
+
+static void test_parse_invalid_unicode_surrogate() {
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDBFF\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\\\\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uDBFF\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDC00\"");
+    TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"a\\uDFFF\\uDC00\"");
+}
+
+#define TEST_UTF8_ERROR(json)\
+    do {\
+        MyJSON myJson(JSON_NULL);\
+        EXPECT_EQ_INT(PARSE_OK, myJson.parse(json));\
+        EXPECT_EQ_INT(PARSE_INVALID_UTF8, myJson.parse(json, true));\
+        EXPECT_EQ_INT(PARSE_INVALID_UTF8, MyJSON::validate(json, strlen(json), nullptr, true));\
+    } while(0)
+
+static void test_parse_utf8() {
+    MyJSON myJson;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("\"\xE2\x82\xAC \xF0\x9D\x84\x9E \xC2\xA2\"", true));
+    /* 多字节字符跨越16字节块 */
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("{\"0123456789abcd\xE4\xB8\xAD\":\"0123456789abcdefghijklmn\xF4\x8F\xBF\xBF\"}", true));
+    EXPECT_EQ_INT(PARSE_OK, MyJSON::validate("\"\xE4\xB8\xAD\"", 5, nullptr, true));
+
+    TEST_UTF8_ERROR("\"\x80\"");                 /* 单独的后续字节 */
+    TEST_UTF8_ERROR("\"\xC0\x80\"");             /* 过长编码 */
+    TEST_UTF8_ERROR("\"\xE0\x80\xAF\"");
+    TEST_UTF8_ERROR("\"\xED\xA0\x80\"");         /* 代理区 */
+    TEST_UTF8_ERROR("\"\xF4\x90\x80\x80\"");     /* 超过U+10FFFF */
+    TEST_UTF8_ERROR("\"\xE2\x82\"");             /* 截断 */
+    TEST_UTF8_ERROR("\"\xFF\"");
+    TEST_UTF8_ERROR("{\"0123456789abcdefghij\xC3\":1}");
+
+    size_t errorOffset;
+    EXPECT_EQ_INT(PARSE_INVALID_UTF8, MyJSON::validate("[\"0123456789abcdefghij\xC3\"]", 25, &errorOffset, true));
+    EXPECT_EQ_SIZE_T(22, errorOffset);
+}
+
 static void test_parse_string() {
     TEST_STRING("", "\"\"");
     TEST_STRING("Hello", "\"Hello\"");
@@ -206,8 +307,14 @@ static void test_parse_string() {
     TEST_STRING("\xF0\x9D\x84\x9E", "\"\\uD834\\uDD1E\"");  /* G clef sign U+1D11E */
     TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\"");  /* G clef sign U+1D11E */
 
+    TEST_STRING("\xF4\x8F\xBF\xBF", "\"\\uDBFF\\uDFFF\"");  /* U+10FFFF */
+    TEST_STRING("\xC2\xAB\xC3\xAF", "\"\\u00aB\\u00eF\"");
+
     test_parse_invalid_string_escape();
     test_parse_invalid_string_char();
+    test_parse_invalid_unicode_hex();
+    test_parse_invalid_unicode_surrogate();
+    test_parse_utf8();
 }
 
 static void test_access_boolean() {
@@ -219,17 +326,13 @@ static void test_access_number() {
     test_parse_number();
 }
 
-#if defined(_MSC_VER)
-#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%Iu")
-#else
-#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%zu")
-#endif
-
 static void test_parse_array() {
     MyJSON myJson;
     EXPECT_EQ_INT(PARSE_OK, myJson.parse("[ ]"));
     EXPECT_EQ_INT(JSON_ARRAY, myJson.getType());
     EXPECT_EQ_SIZE_T(0, myJson.getArray().size());
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("[ 1 , [ ] ,\t\"a\" ]"));
+    EXPECT_EQ_SIZE_T(3, myJson.getArray().size());
 }
 
 
@@ -273,6 +376,34 @@ static void test_stringify_number() {
     TEST_ROUNDTRIP("-1.7976931348623157e+308");
 }
 
+static void test_stringify_raw_number() {
+    /* 数字按原文输出，不经过%.17g */
+    TEST_ROUNDTRIP("1.0");
+    TEST_ROUNDTRIP("1E10");
+    TEST_ROUNDTRIP("0.1");
+    TEST_ROUNDTRIP("[12345678901234567890,3.14159265358979323846264338327950288]");
+    TEST_ROUNDTRIP("{\"id\":505874924095815681}");
+
+    MyJSON myJson;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("12345678901234567"));
+    EXPECT_EQ_INT(1, myJson.getInt64() == 12345678901234567LL);
+    EXPECT_EQ_STRING(std::string("12345678901234567"), myJson.getRawNumber());
+    EXPECT_EQ_DOUBLE(12345678901234568.0, myJson.getNumber());
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("-1.5e2"));
+    EXPECT_EQ_INT(1, myJson.getInt64() == -150);
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("99999999999999999999"));
+    EXPECT_EQ_INT(1, myJson.getInt64() == INT64_MAX);
+
+    MyJSON a, b;
+    EXPECT_EQ_INT(PARSE_OK, a.parse("[1.0]"));
+    EXPECT_EQ_INT(PARSE_OK, b.parse("[1e0]"));
+    EXPECT_EQ_INT(1, a == b);
+
+    std::string json;
+    EXPECT_EQ_INT(STRINGIFY_OK, MyJSON(JSON_NUMBER).jsonStringify(json));
+    EXPECT_EQ_STRING(std::string("0"), json);
+}
+
 static void test_stringify_string() {
     TEST_ROUNDTRIP("\"\"");
     TEST_ROUNDTRIP("\"Hello\"");
@@ -288,8 +419,8 @@ static void test_stringify_array() {
 
 static void test_stringify_object() {
     TEST_ROUNDTRIP("{}");
-//    TEST_ROUNDTRIP(
-//            "{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
+    TEST_ROUNDTRIP(
+            "{\"a\":[1,2,3],\"f\":false,\"i\":123,\"n\":null,\"o\":{\"1\":1,\"2\":2,\"3\":3},\"s\":\"abc\",\"t\":true}");
 }
 
 static void test_stringify() {
@@ -297,14 +428,776 @@ static void test_stringify() {
     TEST_ROUNDTRIP("false");
     TEST_ROUNDTRIP("true");
     test_stringify_number();
+    test_stringify_raw_number();
     test_stringify_string();
     test_stringify_array();
     test_stringify_object();
 }
 
+#define TEST_VALIDATE(error, offset, json)\
+    do {\
+        size_t errorOffset;\
+        EXPECT_EQ_INT(error, MyJSON::validate(json, sizeof(json) - 1, &errorOffset));\
+        EXPECT_EQ_SIZE_T(offset, errorOffset);\
+    } while(0)
+
+static void test_validate() {
+    TEST_VALIDATE(PARSE_OK, 59, " {\"a\":[1,-2.5e3,true,false,null],\"b\":{\"c\":\"\\uD834\\uDD1E\"}} ");
+    TEST_VALIDATE(PARSE_INVALID_VALUE, 5, "[1,2,]");
+    TEST_VALIDATE(PARSE_INVALID_VALUE, 4, "[1, tru]");
+    TEST_VALIDATE(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, 3, "[1 2]");
+    TEST_VALIDATE(PARSE_MISS_COMMA_OR_CURLY_BRACKET, 7, "{\"a\":1 \"b\":2}");
+    TEST_VALIDATE(PARSE_MISS_KEY, 1, "{\"\":1}");
+    TEST_VALIDATE(PARSE_INVALID_STRING_ESCAPE, 3, "\"a\\x\"");
+    TEST_VALIDATE(PARSE_INVALID_UNICODE_HEX, 5, "\"\\u12G4\"");
+    TEST_VALIDATE(PARSE_INVALID_UNICODE_SURROGATE, 7, "\"\\uD800\"");
+    TEST_VALIDATE(PARSE_INVALID_UNICODE_SURROGATE, 7, "\"\\uDBFF\\u0041\"");
+    TEST_VALIDATE(PARSE_INVALID_UNICODE_SURROGATE, 1, "\"\\uDC00\"");
+    TEST_VALIDATE(PARSE_INVALID_STRING_CHAR, 2, "\"a\x01\"");
+    TEST_VALIDATE(PARSE_MISS_QUOTATION_MARK, 4, "\"abc");
+    TEST_VALIDATE(PARSE_NUMBER_TOO_BIG, 1, "[1e309]");
+    TEST_VALIDATE(PARSE_NUMBER_TOO_BIG, 0, "1797693134862315807937289714053034150799341327710418e257");
+    TEST_VALIDATE(PARSE_OK, 3, "1e0");
+    TEST_VALIDATE(PARSE_OK, 23, "1.7976931348623157e+308");
+    TEST_VALIDATE(PARSE_OK, 8, "0.001e-9");
+    TEST_VALIDATE(PARSE_OK, 8, "1e-10000");
+    TEST_VALIDATE(PARSE_ROOT_NOT_SINGULAR, 5, "null x");
+    /* 长度之外的内容不参与校验 */
+    EXPECT_EQ_INT(PARSE_OK, MyJSON::validate("[1]garbage", 3));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, MyJSON::validate("[1]", 2));
+    TEST_VALIDATE(PARSE_MISS_COMMA_OR_CURLY_BRACKET, 12, "[{\"a\":[1,{}]]");
+    TEST_VALIDATE(PARSE_MISS_KEY, 7, "[{\"a\":{,}}]");
+
+    /* 4096层以内的校验不分配内存，'['与'{'交替嵌套时每层都能正确闭合 */
+    std::string open, close;
+    for (int i = 0; i < 4096; i++) {
+        open += i % 3 ? "[" : "{\"k\":";
+        close.insert(close.begin(), i % 3 ? ']' : '}');
+    }
+    std::string mixed = open + "1" + close;
+    size_t before = alloc_count.load();
+    EXPECT_EQ_INT(PARSE_OK, MyJSON::validate(mixed.data(), mixed.size()));
+    EXPECT_EQ_INT(PARSE_OK, MyJSON::validate("[[1,2],{\"a\":[3]}]", 17));
+    EXPECT_EQ_SIZE_T(0, alloc_count.load() - before);
+    mixed = open + "[1}" + close;
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, MyJSON::validate(mixed.data(), mixed.size()));
+
+    /* 嵌套深度不受调用栈限制 */
+    std::string deep = std::string(1000000, '[') + std::string(1000000, ']');
+    EXPECT_EQ_INT(PARSE_OK, MyJSON::validate(deep.data(), deep.size()));
+    deep = std::string(500000, '[') + std::string(500000, '{');
+    size_t errorOffset;
+    EXPECT_EQ_INT(PARSE_MISS_KEY, MyJSON::validate(deep.data(), deep.size(), &errorOffset));
+    EXPECT_EQ_SIZE_T(500001, errorOffset);
+}
+
+#define TEST_PROJECTION(expect, projection, json)\
+    do {\
+        MyJSON myJson;\
+        std::string json2;\
+        EXPECT_EQ_INT(PARSE_OK, myJson.parse(json, projection));\
+        EXPECT_EQ_INT(STRINGIFY_OK, myJson.jsonStringify(json2));\
+        EXPECT_EQ_STRING(std::string(expect), json2);\
+    } while(0)
+
+#define TEST_PROJECTION_ERROR(error, projection, json)\
+    do {\
+        MyJSON myJson;\
+        EXPECT_EQ_INT(error, myJson.parse(json, projection));\
+        EXPECT_EQ_INT(JSON_NULL, myJson.getType());\
+    } while(0)
+
+static void test_parse_projection() {
+    JSONProjection projection{"id", "user.name", "tags"};
+    const char *json = "{\"skip\":{\"a\":[1,{\"b\":\"}]\\\"\"}],\"c\":null},\"id\":7,"
+                       "\"user\":{\"name\":\"x\",\"age\":3,\"n\\u0061m\":1},\"tags\":[{\"t\":1}],\"z\":-1.5e3}";
+    TEST_PROJECTION("{\"id\":7,\"tags\":[{\"t\":1}],\"user\":{\"name\":\"x\"}}", projection, json);
+
+    /* 数组对路径透明 */
+    TEST_PROJECTION("[{\"id\":1},{\"id\":2},{}]", JSONProjection{"id"}, "[{\"id\":1,\"v\":[]},{\"v\":true,\"id\":2},{\"w\":\"\"}]");
+    /* 转义的key也能匹配 */
+    TEST_PROJECTION("{\"name\":1}", JSONProjection{"name"}, "{\"n\\u0061me\":1,\"other\":2}");
+    /* 按key列表添加，可含'.' */
+    JSONProjection dotted;
+    dotted.add(std::vector<std::string>{"a.b"});
+    TEST_PROJECTION("{\"a.b\":1}", dotted, "{\"a\":{\"b\":2},\"a.b\":1}");
+    /* 较短的路径覆盖较长的 */
+    JSONProjection covered{"a.b", "a"};
+    TEST_PROJECTION("{\"a\":{\"b\":1,\"c\":2}}", covered, "{\"a\":{\"b\":1,\"c\":2},\"d\":3}");
+    /* 空投影即完整解析 */
+    TEST_PROJECTION("[1,2]", JSONProjection{}, "[1,2]");
+
+    TEST_PROJECTION_ERROR(PARSE_MISS_QUOTATION_MARK, projection, "{\"skip\":\"abc}");
+    TEST_PROJECTION_ERROR(PARSE_MISS_QUOTATION_MARK, projection, "{\"skip\":[\"\\\"]}");
+    TEST_PROJECTION_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, projection, "{\"skip\":{\"a\":[1]");
+    TEST_PROJECTION_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, projection, "{\"skip\":1");
+    TEST_PROJECTION_ERROR(PARSE_EXPECT_VALUE, projection, "{\"skip\":");
+    TEST_PROJECTION_ERROR(PARSE_INVALID_VALUE, projection, "{\"skip\":,\"id\":1}");
+    TEST_PROJECTION_ERROR(PARSE_MISS_KEY, projection, "{\"\":1}");
+    TEST_PROJECTION_ERROR(PARSE_MISS_COLON, projection, "{\"\" 1}");
+    TEST_PROJECTION_ERROR(PARSE_INVALID_VALUE, projection, "{\"id\":nul}");
+    TEST_PROJECTION_ERROR(PARSE_ROOT_NOT_SINGULAR, projection, "{\"skip\":1} 2");
+}
+
+static void test_parse_interned() {
+    JSONKeyTable keys;
+    JSONParseOptions options;
+    options.keys = &keys;
+    MyJSON a, b;
+    EXPECT_EQ_INT(PARSE_OK, a.parse("{\"id\":1,\"name\":\"x\",\"tags\":[{\"id\":2}]}", options));
+    EXPECT_EQ_INT(PARSE_OK, b.parse("{\"n\\u0061me\":\"y\",\"id\":3}", options));
+    /* 所有文档中相同的key共用一个符号 */
+    EXPECT_EQ_SIZE_T(3, keys.size());
+    const JSONSymbol *id = keys.find("id");
+    EXPECT_EQ_INT(1, id == keys.intern("id"));
+    EXPECT_EQ_INT(1, keys.find("missing") == nullptr);
+    EXPECT_EQ_DOUBLE(1.0, a.getValueFromKey(id).getNumber());
+    EXPECT_EQ_DOUBLE(3.0, b.getValueFromKey(id).getNumber());
+    EXPECT_EQ_STRING(std::string("y"), b.getValueFromKey(keys.find("name")).getString());
+    EXPECT_EQ_DOUBLE(2.0, a.getValueFromKey("tags").getArray()[0].getValueFromKey(id).getNumber());
+    std::string json;
+    EXPECT_EQ_INT(STRINGIFY_OK, a.jsonStringify(json));
+    EXPECT_EQ_STRING(std::string("{\"id\":1,\"name\":\"x\",\"tags\":[{\"id\":2}]}"), json);
+
+    /* 驻留的key和普通key可以互相比较 */
+    MyJSON plain;
+    EXPECT_EQ_INT(PARSE_OK, plain.parse("{\"tags\":[{\"id\":2}],\"id\":1,\"name\":\"x\"}"));
+    EXPECT_EQ_INT(true, plain == a);
+    EXPECT_EQ_INT(false, plain == b);
+    EXPECT_EQ_DOUBLE(1.0, plain.getValueFromKey(id).getNumber());
+    const JSONSymbol *missing = keys.intern("missing");
+    bool thrown = false;
+    try {
+        a.getValueFromKey(missing);
+    } catch (const std::out_of_range &) {
+        thrown = true;
+    }
+    EXPECT_EQ_INT(true, thrown);
+
+    EXPECT_EQ_INT(PARSE_MISS_KEY, a.parse("{\"\":1}", options));
+    options.validateUTF8 = true;
+    EXPECT_EQ_INT(PARSE_INVALID_UTF8, a.parse("{\"\xC0\xAF\":1}", options));
+
+    /* 线程安全的表可被多个线程同时使用 */
+    JSONKeyTable shared(true);
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 0);
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&shared, &ok, t] {
+            JSONParseOptions threadOptions;
+            threadOptions.keys = &shared;
+            for (int i = 0; i < 200; i++) {
+                MyJSON doc;
+                std::string json = "{\"k" + std::to_string(i % 50) + "\":" + std::to_string(t) + ",\"common\":0}";
+                ok[t] += doc.parse(json.c_str(), threadOptions) == PARSE_OK;
+            }
+        });
+    }
+    for (auto &thread: threads) thread.join();
+    for (int t = 0; t < 4; t++) EXPECT_EQ_INT(200, ok[t]);
+    EXPECT_EQ_SIZE_T(51, shared.size());
+}
+
+static void test_parser() {
+    JSONParser parser;
+    const char *messages[] = {
+            "{\"id\":1,\"user\":{\"name\":\"alice \\u00e9\",\"tags\":[\"a\",\"b\",\"c\"]},\"v\":[1.5,2,3]}",
+            "{\"id\":22,\"user\":{\"name\":\"bob\\n\",\"tags\":[\"d\",\"e\"]},\"v\":[4,5,6e1]}",
+            "{\"v\":[7],\"id\":333,\"user\":{\"tags\":[\"long tag value\"],\"name\":\"carol\"}}",
+    };
+    EXPECT_EQ_INT(PARSE_OK, parser.parse(messages[0]));
+    EXPECT_EQ_INT(1, parser.growths() > 0);
+    for (const char *message: messages) EXPECT_EQ_INT(PARSE_OK, parser.parse(message));
+    /* 结构相近的消息再解析一轮，不应再分配 */
+    size_t before = alloc_count.load();
+    for (const char *message: messages) {
+        EXPECT_EQ_INT(PARSE_OK, parser.parse(message));
+        EXPECT_EQ_SIZE_T(0, parser.growths());
+    }
+    EXPECT_EQ_SIZE_T(0, alloc_count.load() - before);
+
+    std::string json;
+    EXPECT_EQ_INT(STRINGIFY_OK, parser.document().jsonStringify(json));
+    EXPECT_EQ_STRING(std::string("{\"id\":333,\"user\":{\"name\":\"carol\",\"tags\":[\"long tag value\"]},\"v\":[7]}"), json);
+
+    /* 复用的存储不会残留在新文档中 */
+    EXPECT_EQ_INT(PARSE_OK, parser.parse("{\"id\":[],\"w\":{}}"));
+    json.clear();
+    EXPECT_EQ_INT(STRINGIFY_OK, parser.document().jsonStringify(json));
+    EXPECT_EQ_STRING(std::string("{\"id\":[],\"w\":{}}"), json);
+    EXPECT_EQ_INT(PARSE_OK, parser.parse("[1,2,3]"));
+    EXPECT_EQ_INT(PARSE_OK, parser.parse("[4]"));
+    EXPECT_EQ_SIZE_T(1, parser.document().getArray().size());
+    EXPECT_EQ_INT(PARSE_OK, parser.parse("{\"a\":1,\"a\":2}"));
+    EXPECT_EQ_DOUBLE(2.0, parser.document().getValueFromKey("a").getNumber());
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, parser.parse("[1 2]"));
+    EXPECT_EQ_INT(JSON_NULL, parser.document().getType());
+
+    /* 同一个MyJSON重复解析也复用存储，数组不会累加 */
+    MyJSON myJson;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("[1,[2,3]]"));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("[4,[5]]"));
+    json.clear();
+    EXPECT_EQ_INT(STRINGIFY_OK, myJson.jsonStringify(json));
+    EXPECT_EQ_STRING(std::string("[4,[5]]"), json);
+
+    /* 使用key驻留表时同样稳定 */
+    JSONKeyTable keys;
+    JSONParseOptions options;
+    options.keys = &keys;
+    JSONParser interned(options);
+    for (const char *message: messages) EXPECT_EQ_INT(PARSE_OK, interned.parse(message));
+    before = alloc_count.load();
+    for (const char *message: messages) {
+        EXPECT_EQ_INT(PARSE_OK, interned.parse(message));
+        EXPECT_EQ_SIZE_T(0, interned.growths());
+    }
+    EXPECT_EQ_SIZE_T(0, alloc_count.load() - before);
+    EXPECT_EQ_INT(1, interned.document().getValueFromKey(keys.find("id")).getNumber() == 333.0);
+}
+
+static void test_parse_policy() {
+    MyJSON myJson;
+    const char *relaxed = "// 注释\n{\"a\":[1,2,/* ] \" */3,],\"b\":{\"c\":null,},} /* 结尾 */";
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONRelaxedPolicy>(relaxed));
+    std::string json;
+    EXPECT_EQ_INT(STRINGIFY_OK, myJson.jsonStringify(json));
+    EXPECT_EQ_STRING(std::string("{\"a\":[1,2,3],\"b\":{\"c\":null}}"), json);
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, myJson.parse<JSONStrictPolicy>("[1,2,]"));
+    EXPECT_EQ_INT(PARSE_MISS_KEY, myJson.parse<JSONStrictPolicy>("{\"a\":1,}"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, myJson.parse<JSONStrictPolicy>("/**/1"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, myJson.parse<JSONRelaxedPolicy>("[,]"));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, myJson.parse<JSONRelaxedPolicy>("1 /* 未闭合"));
+    /* 投影跳过的值中的注释 */
+    JSONParseOptions options;
+    JSONProjection projection{"b"};
+    options.projection = &projection;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONRelaxedPolicy>(relaxed, options));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, myJson.parse<JSONRelaxedPolicy>("{\"a\":[1 /* ]}", options));
+
+    /* UTF-8检查由策略决定 */
+    EXPECT_EQ_INT(PARSE_INVALID_UTF8, myJson.parse<JSONStrictPolicy>("\"\xC0\xAF\""));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONTrustedPolicy>("\"\xC0\xAF\""));
+
+    /* 嵌套层数 */
+    std::string deep(512, '[');
+    deep += std::string(512, ']');
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONStrictPolicy>(deep.c_str()));
+    deep = "{\"a\":" + deep + "}";
+    EXPECT_EQ_INT(PARSE_TOO_DEEP, myJson.parse<JSONStrictPolicy>(deep.c_str()));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONTrustedPolicy>(deep.c_str()));
+
+    /* 数字模式 */
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONDoublePolicy>("1.50"));
+    EXPECT_EQ_DOUBLE(1.5, myJson.getNumber());
+    EXPECT_EQ_STRING(std::string("1.5"), myJson.getRawNumber());
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, myJson.parse<JSONDoublePolicy>("1e309"));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONInt64Policy>("[9223372036854775807,-9223372036854775808,0]"));
+    EXPECT_EQ_INT(1, myJson.getArray()[0].getInt64() == INT64_MAX);
+    EXPECT_EQ_INT(1, myJson.getArray()[1].getInt64() == INT64_MIN);
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, myJson.parse<JSONInt64Policy>("9223372036854775808"));
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, myJson.parse<JSONInt64Policy>("-10000000000000000000"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, myJson.parse<JSONInt64Policy>("1.5"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, myJson.parse<JSONInt64Policy>("1e3"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, myJson.parse<JSONInt64Policy>("-"));
+
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, myJson.parse<JSONInt64Policy>("-9223372036854775809"));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONInt64Policy>("-9223372036854775807"));
+
+    JSONParser parser;
+    EXPECT_EQ_INT(PARSE_OK, parser.parse<JSONRelaxedPolicy>("[1,]"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, parser.parse("[1,]"));
+
+    /* 未预定义的参数组合也能直接使用 */
+    using CustomPolicy = JSONPolicy<true, false, NUMBER_RAW, 0, false>;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<CustomPolicy>("[1, /* x */ \"\xC0\xAF\",]"));
+    using ShallowPolicy = JSONPolicy<false, false, NUMBER_INT64, 2, false>;
+    EXPECT_EQ_INT(PARSE_OK, parser.parse<ShallowPolicy>("[[1]]"));
+    EXPECT_EQ_INT(PARSE_TOO_DEEP, parser.parse<ShallowPolicy>("[[[1]]]"));
+}
+
+static size_t usage_sum(const JSONMemoryUsage &usage) {
+    size_t total = sizeof(MyJSON);
+    for (size_t bytes: usage.bytes) total += bytes;
+    return total;
+}
+
+static void test_memory_usage() {
+    std::string text = "{\"name\":\"" + std::string(100, 'x') + "\",\"list\":[1,2.5,true,null,\"s\"],\"empty\":{}}";
+    MyJSON myJson;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse(text.c_str()));
+    JSONMemoryUsage usage = myJson.memoryUsage();
+    EXPECT_EQ_SIZE_T(2, usage.nodes[JSON_OBJECT]);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[JSON_ARRAY]);
+    EXPECT_EQ_SIZE_T(2, usage.nodes[JSON_STRING]);
+    EXPECT_EQ_SIZE_T(2, usage.nodes[JSON_NUMBER]);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[JSON_TRUE]);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[JSON_NULL]);
+    EXPECT_EQ_SIZE_T(usage_sum(usage), usage.total);
+    EXPECT_EQ_INT(1, usage.bytes[JSON_STRING] >= 101);
+    EXPECT_EQ_INT(1, usage.containerBytes >= 5 * sizeof(MyJSON));
+    EXPECT_EQ_SIZE_T(0, usage.bytes[JSON_NULL]);
+
+    /* 复用存储后留下的余量可以被compact释放 */
+    JSONParser parser;
+    EXPECT_EQ_INT(PARSE_OK, parser.parse(text.c_str()));
+    EXPECT_EQ_INT(PARSE_OK, parser.parse("{\"name\":\"y\",\"list\":[1],\"empty\":1}"));
+    MyJSON &document = parser.document();
+    JSONMemoryUsage before = document.memoryUsage();
+    EXPECT_EQ_INT(1, before.slackBytes > 0);
+    document.compact();
+    JSONMemoryUsage after = document.memoryUsage();
+    EXPECT_EQ_SIZE_T(0, after.slackBytes);
+    EXPECT_EQ_SIZE_T(0, after.stringBytes);
+    EXPECT_EQ_INT(1, after.total < before.total);
+    MyJSON expect;
+    EXPECT_EQ_INT(PARSE_OK, expect.parse("{\"name\":\"y\",\"list\":[1],\"empty\":1}"));
+    EXPECT_EQ_INT(true, expect == document);
+
+    /* 重新分配后内容不变 */
+    JSONKeyTable keys;
+    JSONParseOptions options;
+    options.keys = &keys;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse(text.c_str(), options));
+    EXPECT_EQ_SIZE_T(0, myJson.memoryUsage().keyBytes);
+    myJson.compact(true);
+    EXPECT_EQ_INT(PARSE_OK, expect.parse(text.c_str()));
+    EXPECT_EQ_INT(true, expect == myJson);
+    EXPECT_EQ_INT(1, myJson.getValueFromKey(keys.find("name")).getString().size() == 100);
+    EXPECT_EQ_SIZE_T(0, myJson.memoryUsage().slackBytes);
+}
+
+static void write_file(const char *path, const std::string &content) {
+    FILE *file = fopen(path, "wb");
+    fwrite(content.data(), 1, content.size(), file);
+    fclose(file);
+}
+
+/* 按记录序号收集每条记录的"id"，返回解析结果 */
+static JSONParseResult ingest_ids(const char *path, const std::string &content, const JSONIngestOptions &options,
+                                  std::vector<int> &ids, size_t *errorRecord = nullptr) {
+    write_file(path, content);
+    std::mutex mutex;
+    ids.clear();
+    JSONIngest ingest(options);
+    JSONParseResult ret = ingest.run(path, [&](size_t record, MyJSON &value, unsigned) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ids.size() <= record) ids.resize(record + 1, -1);
+        ids[record] = (int) value.getValueFromKey("id").getNumber();
+    }, errorRecord);
+    remove(path);
+    return ret;
+}
+
+static void test_ingest() {
+    const char *path = "my_json_ingest_test.json";
+    /* 块很小，多数记录跨越块边界，长记录使块扩大 */
+    std::string lines, array = " [";
+    for (int i = 0; i < 200; i++) {
+        std::string record = "{\"id\":" + std::to_string(i) + ",\"s\":\"a,]}\\\"\\n" +
+                             std::string(i % 7 == 0 ? 300 : i % 20, 'x') + "\",\"v\":[1,{\"w\":2}]}";
+        lines += record + (i % 3 == 0 ? "\r\n" : "\n");
+        if (i) array += i % 2 ? "," : " ,\n";
+        array += record;
+    }
+    array += "]\n";
+    JSONIngestOptions options;
+    options.bufferSize = 64;
+    options.buffers = 3;
+    options.workers = 3;
+    std::vector<int> ids;
+    EXPECT_EQ_INT(PARSE_OK, ingest_ids(path, lines, options, ids));
+    EXPECT_EQ_SIZE_T(200, ids.size());
+    int ordered = 0;
+    for (int i = 0; i < (int) ids.size(); i++) ordered += ids[i] == i;
+    EXPECT_EQ_INT(200, ordered);
+
+    options.format = INGEST_JSON_ARRAY;
+    EXPECT_EQ_INT(PARSE_OK, ingest_ids(path, array, options, ids));
+    EXPECT_EQ_SIZE_T(200, ids.size());
+    ordered = 0;
+    for (int i = 0; i < (int) ids.size(); i++) ordered += ids[i] == i;
+    EXPECT_EQ_INT(200, ordered);
+
+    /* 大块、单线程，结果相同 */
+    options.bufferSize = 1 << 16;
+    options.workers = 1;
+    EXPECT_EQ_INT(PARSE_OK, ingest_ids(path, array, options, ids));
+    EXPECT_EQ_SIZE_T(200, ids.size());
+    EXPECT_EQ_INT(PARSE_OK, ingest_ids(path, " [ ] ", options, ids));
+    EXPECT_EQ_SIZE_T(0, ids.size());
+
+    size_t errorRecord = 0;
+    EXPECT_EQ_INT(PARSE_EXPECT_VALUE, ingest_ids(path, "[{\"id\":1},]", options, ids, &errorRecord));
+    EXPECT_EQ_SIZE_T(1, errorRecord);
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, ingest_ids(path, "[{\"id\":1}", options, ids));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, ingest_ids(path, "[{\"id\":1}] 2", options, ids));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, ingest_ids(path, "{\"id\":1}", options, ids));
+
+    /* 切分出错之前的记录照常解析，报告文件中的第一个错误 */
+    options.bufferSize = 1 << 16;
+    options.workers = 2;
+    EXPECT_EQ_INT(PARSE_MISS_COLON, ingest_ids(path, "[{\"id\":1},{\"id\" 2},{\"id\":3}", options, ids, &errorRecord));
+    EXPECT_EQ_SIZE_T(1, errorRecord);
+    EXPECT_EQ_INT(1, ids.size() >= 1 && ids[0] == 1);
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, ingest_ids(path, "[{\"id\":1},{\"id\":2}] 3", options, ids, &errorRecord));
+    EXPECT_EQ_SIZE_T(2, errorRecord);
+    EXPECT_EQ_SIZE_T(2, ids.size());
+
+    /* 共用的驻留表不是线程安全的，只用一个解析线程 */
+    JSONKeyTable keys;
+    options.parse.keys = &keys;
+    options.workers = 4;
+    write_file(path, array);
+    std::atomic<unsigned> maxWorker{0};
+    JSONIngest shared(options);
+    EXPECT_EQ_INT(PARSE_OK, shared.run(path, [&](size_t, MyJSON &, unsigned worker) {
+        if (worker > maxWorker) maxWorker = worker;
+    }));
+    remove(path);
+    EXPECT_EQ_SIZE_T(200, shared.stats().records);
+    EXPECT_EQ_INT(0, maxWorker.load());
+    EXPECT_EQ_INT(1, keys.find("id") != nullptr);
+    options.parse.keys = nullptr;
+
+    /* 空行被跳过，但仍计入行号 */
+    options.format = INGEST_JSON_LINES;
+    options.bufferSize = 16;
+    options.workers = 2;
+    EXPECT_EQ_INT(PARSE_OK, ingest_ids(path, "\n{\"id\":1}\n  \n{\"id\":3}", options, ids));
+    EXPECT_EQ_SIZE_T(4, ids.size());
+    EXPECT_EQ_INT(3, ids[3]);
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+                  ingest_ids(path, "{\"id\":0}\n{\"id\":1}\n{\"id\":2\n{\"id\":3}\n{\"id\"}\n", options, ids, &errorRecord));
+    EXPECT_EQ_SIZE_T(2, errorRecord);
+
+    JSONIngest ingest;
+    EXPECT_EQ_INT(PARSE_IO_ERROR, ingest.run("my_json_no_such_file.json", [](size_t, MyJSON &, unsigned) {}));
+}
+
+static void check_columns(const JSONColumns &columns) {
+    EXPECT_EQ_SIZE_T(10, columns.rows());
+    const JSONColumn &ts = columns["ts"];
+    const JSONColumn &v = columns["v"];
+    const JSONColumn &host = columns["host"];
+    EXPECT_EQ_SIZE_T(10, ts.ints.size());
+    EXPECT_EQ_SIZE_T(10, v.doubles.size());
+    EXPECT_EQ_SIZE_T(11, host.offsets.size());
+    EXPECT_EQ_SIZE_T(2, host.validity.size());
+    EXPECT_EQ_INT(1, ts.ints[0] == 1681000000000LL);
+    EXPECT_EQ_DOUBLE(0.5, v.doubles[0]);
+    EXPECT_EQ_STRING(std::string("a\nb"), std::string(host.getString(0)));
+    EXPECT_EQ_INT(false, host.isNull(0));
+    /* null和缺失的key都是空值 */
+    EXPECT_EQ_INT(true, v.isNull(1));
+    EXPECT_EQ_INT(true, host.isNull(1));
+    EXPECT_EQ_DOUBLE(0.0, v.doubles[1]);
+    EXPECT_EQ_STRING(std::string(""), std::string(host.getString(1)));
+    EXPECT_EQ_INT(true, ts.isNull(2));
+    EXPECT_EQ_INT(false, v.isNull(2));
+    EXPECT_EQ_STRING(std::string("\xE2\x82\xAC"), std::string(host.getString(2)));
+    for (size_t row = 3; row < 10; row++) {
+        EXPECT_EQ_INT(false, ts.isNull(row));
+        EXPECT_EQ_INT(1, ts.ints[row] == (int64_t) row);
+        EXPECT_EQ_DOUBLE((double) row, v.doubles[row]);
+        EXPECT_EQ_STRING(std::to_string(row), std::string(host.getString(row)));
+    }
+}
+
+static void test_columns() {
+    const char *json = "[{\"ts\":1681000000000,\"v\":0.5,\"host\":\"a\\nb\",\"x\":{\"y\":[1]}},"
+                       " {\"ts\":1,\"v\":null},"
+                       " {\"host\":\"\\u20AC\",\"ts\":null,\"v\":-2e0},"
+                       " {\"ts\":3,\"v\":3,\"host\":\"3\"},{\"ts\":4,\"v\":4,\"host\":\"4\"},"
+                       " {\"ts\":5,\"v\":5,\"host\":\"5\"},{\"ts\":6,\"v\":6,\"host\":\"6\"},"
+                       " {\"ts\":7,\"v\":7,\"host\":\"7\"},{\"ts\":8,\"v\":8,\"host\":\"8\"},"
+                       " {\"ts\":9,\"v\":9,\"host\":\"9\",\"ts\":10}]";
+    JSONColumns columns;
+    columns.addColumn("ts", COLUMN_INT64);
+    columns.addColumn("v", COLUMN_DOUBLE);
+    columns.addColumn("host", COLUMN_STRING);
+    EXPECT_EQ_INT(PARSE_OK, columns.parse(json));
+    check_columns(columns);
+
+    MyJSON myJson;
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("[{\"ts\":1681000000000,\"v\":0.5,\"host\":\"a\\nb\"},{\"ts\":1},"
+                                         "{\"host\":\"\\u20AC\",\"v\":-2e0},{\"ts\":3,\"v\":3,\"host\":\"3\"},"
+                                         "{\"ts\":4,\"v\":4,\"host\":\"4\"},{\"ts\":5,\"v\":5,\"host\":\"5\"},"
+                                         "{\"ts\":6,\"v\":6,\"host\":\"6\"},{\"ts\":7,\"v\":7,\"host\":\"7\"},"
+                                         "{\"ts\":8,\"v\":8,\"host\":\"8\"},{\"ts\":9,\"v\":9,\"host\":\"9\"}]"));
+    JSONColumns extracted;
+    extracted.addColumn("ts", COLUMN_INT64);
+    extracted.addColumn("v", COLUMN_DOUBLE);
+    extracted.addColumn("host", COLUMN_STRING);
+    EXPECT_EQ_INT(PARSE_OK, extracted.extract(myJson));
+    check_columns(extracted);
+
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, columns.parse("[{\"ts\":1.5}]"));
+    EXPECT_EQ_SIZE_T(0, columns.rows());
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, columns.parse("[{\"host\":1}]"));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, columns.parse("[1]"));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, columns.parse("{}"));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, columns.parse("[{} {}]"));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET, columns.parse("[{\"ts\":1]"));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, columns.parse("[{\"x\":nul}]"));
+    EXPECT_EQ_INT(PARSE_MISS_COLON, columns.parse("[{\"\" 1}]"));
+    EXPECT_EQ_INT(PARSE_MISS_KEY, columns.parse("[{\"\":1}]"));
+    EXPECT_EQ_INT(PARSE_EXPECT_VALUE, columns.parse("[{\"host\":"));
+    EXPECT_EQ_INT(PARSE_EXPECT_VALUE, columns.parse("[{\"ts\": "));
+    EXPECT_EQ_INT(PARSE_OK, columns.parse(" [ ] "));
+    EXPECT_EQ_SIZE_T(0, columns.rows());
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("[{\"ts\":1e3}]"));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, extracted.extract(myJson));
+
+    /* 超出int64时两种方式都报PARSE_NUMBER_TOO_BIG */
+    const char *big = "[{\"ts\":9223372036854775807},{\"ts\":-9223372036854775809}]";
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, columns.parse(big));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse(big));
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, extracted.extract(myJson));
+    EXPECT_EQ_SIZE_T(0, extracted.rows());
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONDoublePolicy>("[{\"ts\":-9223372036854775808},{\"ts\":1e19}]"));
+    EXPECT_EQ_INT(PARSE_NUMBER_TOO_BIG, extracted.extract(myJson));
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse<JSONDoublePolicy>("[{\"ts\":-9223372036854775808}]"));
+    EXPECT_EQ_INT(PARSE_OK, extracted.extract(myJson));
+    EXPECT_EQ_INT(1, extracted["ts"].ints[0] == INT64_MIN);
+
+    bool thrown = false;
+    try {
+        extracted["missing"];
+    } catch (const std::out_of_range &) {
+        thrown = true;
+    }
+    EXPECT_EQ_INT(true, thrown);
+}
+
+static void test_format() {
+    const char *json = " { \"a\" : [ 1.0e+00 , -0 , 12345678901234567890 ] ,\n\t\"b \\\" c\" : { } ,"
+                       " \"d\" : [ ] , \"e\" : { \"f\" : \"  x  \\\\\" , \"g\" : null } } ";
+    std::string minified;
+    JSONFormatter::minify(json, strlen(json), minified);
+    EXPECT_EQ_STRING(std::string("{\"a\":[1.0e+00,-0,12345678901234567890],\"b \\\" c\":{},\"d\":[],"
+                                 "\"e\":{\"f\":\"  x  \\\\\",\"g\":null}}"), minified);
+
+    std::string pretty;
+    JSONFormatter::prettify(json, strlen(json), pretty, 2);
+    EXPECT_EQ_STRING(std::string("{\n"
+                                 "  \"a\": [\n"
+                                 "    1.0e+00,\n"
+                                 "    -0,\n"
+                                 "    12345678901234567890\n"
+                                 "  ],\n"
+                                 "  \"b \\\" c\": {},\n"
+                                 "  \"d\": [],\n"
+                                 "  \"e\": {\n"
+                                 "    \"f\": \"  x  \\\\\",\n"
+                                 "    \"g\": null\n"
+                                 "  }\n"
+                                 "}"), pretty);
+
+    /* 任意切分输入，结果不变 */
+    for (size_t split = 0; split <= strlen(json); split++) {
+        std::string chunked;
+        JSONFormatter formatter(chunked, 2);
+        formatter.feed(json, split);
+        formatter.feed(json + split, strlen(json) - split);
+        EXPECT_EQ_INT(1, chunked == pretty);
+        chunked.clear();
+        JSONFormatter minifier(chunked);
+        minifier.feed(json, split);
+        minifier.feed(json + split, strlen(json) - split);
+        EXPECT_EQ_INT(1, chunked == minified);
+    }
+
+    std::string roundtrip;
+    JSONFormatter::minify(pretty.data(), pretty.size(), roundtrip);
+    EXPECT_EQ_STRING(minified, roundtrip);
+
+    /* 空白和内容交错的长输入，每种缩进下都能还原 */
+    std::string wide = "[";
+    for (int i = 0; i < 200; i++) wide += (i ? ",{\"k" : "{\"k") + std::to_string(i) + "\":[true,\" \\\" \",-1.5e3]}";
+    wide += "]";
+    for (unsigned indent = 1; indent <= 9; indent++) {
+        pretty.clear();
+        JSONFormatter::prettify(wide.data(), wide.size(), pretty, indent);
+        roundtrip.clear();
+        JSONFormatter::minify(pretty.data(), pretty.size(), roundtrip);
+        EXPECT_EQ_INT(1, roundtrip == wide);
+    }
+
+    /* 多余的闭括号不会使缩进下溢 */
+    pretty.clear();
+    JSONFormatter::prettify("]]", 2, pretty, 2);
+    EXPECT_EQ_STRING(std::string("\n]\n]"), pretty);
+}
+
+struct BindUser {
+    std::string name;
+    int age = 0;
+};
+
+struct BindMessage {
+    long long id = 0;
+    double score = 0;
+    bool ok = false;
+    std::vector<int> tags;
+    std::optional<std::string> note;
+    BindUser user;
+    std::vector<BindUser> friends;
+};
+
+struct BindShape {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int id = 0;
+    int ix = 0;
+};
+
+MY_JSON_BINDING(BindUser, MY_JSON_FIELD(BindUser, name), MY_JSON_FIELD(BindUser, age))
+
+MY_JSON_BINDING(BindShape, MY_JSON_FIELD(BindShape, width), MY_JSON_FIELD(BindShape, x), MY_JSON_FIELD(BindShape, ix),
+                MY_JSON_FIELD(BindShape, y), MY_JSON_FIELD(BindShape, id))
+
+MY_JSON_BINDING(BindMessage, MY_JSON_FIELD(BindMessage, id), MY_JSON_FIELD(BindMessage, score),
+                MY_JSON_FIELD(BindMessage, ok), MY_JSON_FIELD(BindMessage, tags), MY_JSON_FIELD(BindMessage, note),
+                MY_JSON_FIELD(BindMessage, user), MY_JSON_FIELD(BindMessage, friends))
+
+#define TEST_BIND_ERROR(error, type, json)\
+    do {\
+        type value;\
+        EXPECT_EQ_INT(error, jsonParse(json, value));\
+    } while(0)
+
+static void test_bind() {
+    BindMessage message;
+    EXPECT_EQ_INT(PARSE_OK, jsonParse(
+            " { \"id\" : 12345678901234, \"score\":1.5, \"unknown\":[{\"x\":[1,\"\\u00A2\"]},null],"
+            "\"ok\":true, \"tags\":[1,2,3], \"note\":null, \"user\":{\"na\\u006De\":\"a\\nb\",\"age\":30},"
+            "\"friends\":[{\"name\":\"c\"},{\"age\":1}] } ", message));
+    EXPECT_EQ_INT(1, message.id == 12345678901234LL);
+    EXPECT_EQ_DOUBLE(1.5, message.score);
+    EXPECT_EQ_INT(true, message.ok);
+    EXPECT_EQ_SIZE_T(3, message.tags.size());
+    EXPECT_EQ_INT(3, message.tags[2]);
+    EXPECT_EQ_INT(false, message.note.has_value());
+    EXPECT_EQ_STRING(std::string("a\nb"), message.user.name);
+    EXPECT_EQ_INT(30, message.user.age);
+    EXPECT_EQ_SIZE_T(2, message.friends.size());
+    EXPECT_EQ_STRING(std::string("c"), message.friends[0].name);
+    EXPECT_EQ_INT(1, message.friends[1].age);
+
+    message.note = "\"hi\"";
+    std::string json;
+    EXPECT_EQ_INT(STRINGIFY_OK, jsonStringify(message, json));
+    EXPECT_EQ_STRING(std::string("{\"id\":12345678901234,\"score\":1.5,\"ok\":true,\"tags\":[1,2,3],"
+                                 "\"note\":\"\\\"hi\\\"\",\"user\":{\"name\":\"a\\nb\",\"age\":30},"
+                                 "\"friends\":[{\"name\":\"c\",\"age\":0},{\"name\":\"\",\"age\":1}]}"), json);
+    BindMessage message2;
+    EXPECT_EQ_INT(PARSE_OK, jsonParse(json.c_str(), message2));
+    EXPECT_EQ_STRING(std::string("\"hi\""), message2.note.value());
+
+    TEST_BIND_ERROR(PARSE_EXPECT_VALUE, BindUser, "");
+    TEST_BIND_ERROR(PARSE_TYPE_MISMATCH, BindUser, "[]");
+    TEST_BIND_ERROR(PARSE_TYPE_MISMATCH, BindUser, "{\"age\":\"1\"}");
+    TEST_BIND_ERROR(PARSE_TYPE_MISMATCH, BindUser, "{\"age\":1.5}");
+    TEST_BIND_ERROR(PARSE_NUMBER_TOO_BIG, BindUser, "{\"age\":12345678901}");
+    TEST_BIND_ERROR(PARSE_MISS_COLON, BindUser, "{\"age\"}");
+    TEST_BIND_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, BindUser, "{\"age\":1");
+    TEST_BIND_ERROR(PARSE_INVALID_VALUE, BindUser, "{\"x\":nul}");
+    TEST_BIND_ERROR(PARSE_ROOT_NOT_SINGULAR, BindUser, "{} x");
+    TEST_BIND_ERROR(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, std::vector<int>, "[1 2]");
+    TEST_BIND_ERROR(PARSE_MISS_COLON, BindUser, "{\"\" 1}");
+    TEST_BIND_ERROR(PARSE_MISS_KEY, BindUser, "{\"\":1}");
+    TEST_BIND_ERROR(PARSE_NUMBER_TOO_BIG, std::vector<double>, "[1e309]");
+    TEST_BIND_ERROR(PARSE_NUMBER_TOO_BIG, float, "1e39");
+    TEST_BIND_ERROR(PARSE_NUMBER_TOO_BIG, float, "-1e39");
+    float f;
+    EXPECT_EQ_INT(PARSE_OK, jsonParse("3.4028234663852886e+38", f));
+    EXPECT_EQ_INT(1, f == std::numeric_limits<float>::max());
+    TEST_BIND_ERROR(PARSE_INVALID_UNICODE_HEX, std::string, "\"\\u12\"");
+
+    // 长度和首字节相同的字段
+    BindShape shape;
+    EXPECT_EQ_INT(PARSE_OK, jsonParse("{\"ix\":1,\"id\":2,\"y\":3,\"x\":4,\"i\":5,\"width\":6,\"iz\":7}", shape));
+    EXPECT_EQ_INT(1, shape.ix);
+    EXPECT_EQ_INT(2, shape.id);
+    EXPECT_EQ_INT(3, shape.y);
+    EXPECT_EQ_INT(4, shape.x);
+    EXPECT_EQ_INT(6, shape.width);
+    json.clear();
+    EXPECT_EQ_INT(STRINGIFY_OK, jsonStringify(shape, json));
+    EXPECT_EQ_STRING(std::string("{\"width\":6,\"x\":4,\"ix\":1,\"y\":3,\"id\":2}"), json);
+
+    // 默认不检查UTF-8
+    std::string text;
+    EXPECT_EQ_INT(PARSE_OK, jsonParse("\"\xC0\xAF\"", text));
+    EXPECT_EQ_INT(PARSE_INVALID_UTF8, jsonParse("\"\xC0\xAF\"", text, true));
+    EXPECT_EQ_INT(PARSE_INVALID_UTF8, jsonParse("{\"\xFF\":1}", shape, true));
+    EXPECT_EQ_INT(PARSE_OK, jsonParse("\"\xE2\x82\xAC\\u00A2\"", text, true));
+    EXPECT_EQ_STRING(std::string("\xE2\x82\xAC\xC2\xA2"), text);
+}
+
+#ifdef MY_JSON_STATS
+static JSONStats last_stats;
+
+static void test_stats() {
+    JSONStatsHooks hooks;
+    hooks.report = [](const JSONStats &stats) { last_stats = stats; };
+    MyJSON::setStatsHooks(hooks);
+
+    MyJSON myJson;
+    const char *json = " [1,\"a\\nb\",[true,null],\"\\u00A2\"] ";
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse(json));
+    EXPECT_EQ_INT(STATS_PARSE, last_stats.op);
+    EXPECT_EQ_INT(PARSE_OK, last_stats.result);
+    EXPECT_EQ_SIZE_T(strlen(json), last_stats.bytes);
+    EXPECT_EQ_SIZE_T(2, last_stats.nodes[JSON_ARRAY]);
+    EXPECT_EQ_SIZE_T(1, last_stats.nodes[JSON_NUMBER]);
+    EXPECT_EQ_SIZE_T(2, last_stats.nodes[JSON_STRING]);
+    EXPECT_EQ_SIZE_T(1, last_stats.nodes[JSON_TRUE]);
+    EXPECT_EQ_SIZE_T(1, last_stats.nodes[JSON_NULL]);
+    EXPECT_EQ_SIZE_T(3, last_stats.maxDepth);
+    EXPECT_EQ_SIZE_T(3, last_stats.longestString);
+    EXPECT_EQ_SIZE_T(2, last_stats.escapes);
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRING] > 0 && last_stats.phaseSeconds[PHASE_NUMBER] > 0);
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRING] + last_stats.phaseSeconds[PHASE_NUMBER] <= last_stats.seconds);
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRUCTURE] >= 0);
+
+    std::string out;
+    EXPECT_EQ_INT(STRINGIFY_OK, myJson.jsonStringify(out));
+    EXPECT_EQ_INT(STATS_STRINGIFY, last_stats.op);
+    EXPECT_EQ_SIZE_T(out.size(), last_stats.bytes);
+    EXPECT_EQ_SIZE_T(2, last_stats.nodes[JSON_ARRAY]);
+    EXPECT_EQ_SIZE_T(3, last_stats.maxDepth);
+    EXPECT_EQ_SIZE_T(1, last_stats.escapes);
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRING] > 0 && last_stats.phaseSeconds[PHASE_NUMBER] > 0);
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRING] + last_stats.phaseSeconds[PHASE_NUMBER] <= last_stats.seconds);
+
+    /* 不含字符串和数字的文档只有结构耗时 */
+    EXPECT_EQ_INT(PARSE_OK, myJson.parse("[true,[null]]"));
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRING] == 0 && last_stats.phaseSeconds[PHASE_NUMBER] == 0);
+    EXPECT_EQ_INT(1, last_stats.phaseSeconds[PHASE_STRUCTURE] > 0);
+
+    MyJSON::setStatsHooks(JSONStatsHooks());
+}
+#endif
+
 int main() {
     test_parse();
     test_stringify();
+    test_parse_projection();
+    test_parse_interned();
+    test_parser();
+    test_parse_policy();
+    test_ingest();
+    test_memory_usage();
+    test_validate();
+    test_columns();
+    test_format();
+    test_bind();
+#ifdef MY_JSON_STATS
+    test_stats();
+#endif
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
-    return 0;
+    return main_ret;
 }
\ No newline at end of file